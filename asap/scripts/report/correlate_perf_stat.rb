@@ -0,0 +1,91 @@
+#!/usr/bin/env ruby
+
+# Compares the overhead reduction that ASAP predicts with the one that is
+# actually measured.
+#
+# Usage:
+#   correlate_perf_stat.rb [--event=cycles] <full.perf> <baseline.perf> \
+#       <report.yaml>:<asap.perf> [<report.yaml>:<asap.perf> ...]
+#
+# full.perf and baseline.perf are the `perf stat` outputs of the program with
+# all checks and with no checks at all. Each report.yaml is the output of
+# `asap-clang -asap-report` for one ASAP build, and asap.perf the `perf stat`
+# output of that build.
+#
+# The predicted reduction is the fraction of the checks' cost that ASAP
+# removed; the achieved reduction is the fraction of the checks' overhead
+# (full - baseline) that the ASAP build no longer has.
+
+require 'yaml'
+
+event = 'cycles'
+args = ARGV.reject do |arg|
+  if arg =~ /^--event=(.+)$/
+    event = $1
+    true
+  end
+end
+
+if args.size < 3
+  $stderr.puts "Usage: #{$0} [--event=cycles] <full.perf> <baseline.perf> <report.yaml>:<asap.perf>..."
+  exit 1
+end
+
+def read_perf_stat(file, event)
+  IO.foreach(file) do |line|
+    return $1.delete(',').to_f if line =~ /([\d.,]+) \s+ #{Regexp.escape(event)}\b/x
+  end
+  raise "#{file}: no #{event} found"
+end
+
+# Sums up the module documents of a report. The summary document written by
+# asap-clang is recognized by its lack of a module name.
+def read_report(file)
+  total_cost = 0
+  removed_cost = 0
+  File.open(file) do |f|
+    YAML.load_stream(f) do |doc|
+      next unless doc.is_a?(Hash) and doc.include?('module')
+      total_cost += doc['total-cost']
+      removed_cost += doc['removed-cost']
+    end
+  end
+  raise "#{file}: no module reports found" if total_cost == 0
+  removed_cost.to_f / total_cost
+end
+
+full = read_perf_stat(args[0], event)
+baseline = read_perf_stat(args[1], event)
+overhead = full - baseline
+raise "checks have no measurable overhead" unless overhead > 0
+
+results = args[2..-1].map do |pair|
+  report, perf = pair.split(':', 2)
+  raise "expected <report.yaml>:<asap.perf>, got #{pair}" unless perf
+  predicted = read_report(report)
+  achieved = (full - read_perf_stat(perf, event)) / overhead
+  [report, predicted, achieved]
+end
+
+puts "%-40s\t%10s\t%10s\t%10s" % ['report', 'predicted', 'achieved', 'error']
+results.each do |report, predicted, achieved|
+  puts "%-40s\t%9.2f%%\t%9.2f%%\t%9.2f%%" %
+       [report, 100 * predicted, 100 * achieved, 100 * (achieved - predicted)]
+end
+
+n = results.size
+mean_error = results.map { |_, p, a| (a - p).abs }.reduce(:+) / n
+puts
+puts "Overhead of all checks: %.2f%% of baseline #{event}" % (100 * overhead / baseline)
+puts "Mean absolute error: %.2f%%" % (100 * mean_error)
+
+if n >= 2
+  mp = results.map { |_, p, _| p }.reduce(:+) / n
+  ma = results.map { |_, _, a| a }.reduce(:+) / n
+  cov = results.map { |_, p, a| (p - mp) * (a - ma) }.reduce(:+)
+  vp = results.map { |_, p, _| (p - mp)**2 }.reduce(:+)
+  va = results.map { |_, _, a| (a - ma)**2 }.reduce(:+)
+  if vp > 0 and va > 0
+    puts "Correlation (Pearson): %.3f" % (cov / Math.sqrt(vp * va))
+  end
+end
@@ -18,6 +18,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/ADT/iterator.h"
 #include "llvm/Support/Debug.h"
@@ -398,9 +399,18 @@ public:
 class CoverageMapping {
   std::vector<FunctionRecord> Functions;
   unsigned MismatchedFunctionCount;
+  /// \brief The functions that have a main view in each file, as indices
+  /// into Functions.
+  StringMap<std::vector<unsigned>> FunctionsByFile;
 
   CoverageMapping() : MismatchedFunctionCount(0) {}
 
+  /// \brief Fill FunctionsByFile, once all functions are loaded.
+  void indexFunctionsByFile();
+
+  /// \brief Get the functions that have a main view in the given file.
+  ArrayRef<unsigned> getFunctionsInFile(StringRef Filename) const;
+
 public:
   /// \brief Load the coverage mapping using the given readers.
   static ErrorOr<std::unique_ptr<CoverageMapping>>
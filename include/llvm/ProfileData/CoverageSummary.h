@@ -0,0 +1,108 @@
+//=-- CoverageSummary.h - Per-function coverage summaries ---------*- C++ -*-=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains support for writing and reading a compact binary summary
+// of the code regions of each function, with their execution counts and
+// nesting depths. The summary is computed in a single pass over the coverage
+// mapping records, and is meant for tools that need hotness data without
+// rendering or re-evaluating the coverage mapping.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PROFILEDATA_COVERAGESUMMARY_H
+#define LLVM_PROFILEDATA_COVERAGESUMMARY_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace llvm {
+
+class IndexedInstrProfReader;
+class raw_ostream;
+
+namespace coverage {
+
+class CoverageMappingReader;
+
+/// \brief The magic number at the start of a coverage summary ("lcovsum\x81").
+const uint64_t CoverageSummaryMagic = 0x816d7573766f636cULL;
+
+/// \brief The version of the coverage summary format.
+const uint64_t CoverageSummaryVersion = 1;
+
+/// \brief A code region of a function, with its execution count.
+struct RegionSummary {
+  /// \brief The file of the region, as an index into the function's
+  /// Filenames.
+  unsigned FileID;
+  unsigned LineStart, ColumnStart, LineEnd, ColumnEnd;
+  /// \brief The number of enclosing code regions in the same file.
+  unsigned Depth;
+  uint64_t ExecutionCount;
+};
+
+/// \brief The code regions of a function.
+///
+/// Skipped and expansion regions are not included; the regions of an
+/// expanded macro or #included file are listed with their own FileID.
+struct FunctionSummary {
+  /// \brief The name of the function in the profile, i.e., with the file
+  /// name prefix of functions with local linkage.
+  StringRef Name;
+  uint64_t FunctionHash;
+  /// \brief The execution count of the function's first region.
+  uint64_t ExecutionCount;
+  std::vector<StringRef> Filenames;
+  /// \brief Regions ordered by file, then by start location.
+  std::vector<RegionSummary> Regions;
+};
+
+/// \brief Write the summary of each function that has a coverage mapping.
+///
+/// Functions whose profile does not match their coverage mapping are
+/// skipped, as in CoverageMapping::load.
+std::error_code writeCoverageSummary(CoverageMappingReader &CoverageReader,
+                                     IndexedInstrProfReader &ProfileReader,
+                                     raw_ostream &OS);
+
+/// \brief Write the summary of each function with the given coverage mapping
+/// and profile files.
+std::error_code writeCoverageSummary(StringRef ObjectFilename,
+                                     StringRef ProfileFilename,
+                                     raw_ostream &OS,
+                                     StringRef Arch = StringRef());
+
+/// \brief Reader for the summaries written by writeCoverageSummary.
+class CoverageSummaryReader {
+  std::unique_ptr<MemoryBuffer> Buffer;
+  const char *Cur;
+
+  CoverageSummaryReader(std::unique_ptr<MemoryBuffer> Buffer);
+
+public:
+  static ErrorOr<std::unique_ptr<CoverageSummaryReader>>
+  create(std::unique_ptr<MemoryBuffer> Buffer);
+
+  static ErrorOr<std::unique_ptr<CoverageSummaryReader>>
+  create(StringRef Path);
+
+  /// \brief Read the next function. Names refer into the reader's buffer.
+  ///
+  /// Returns coveragemap_error::eof after the last function.
+  std::error_code readNextFunction(FunctionSummary &Function);
+};
+
+} // end namespace coverage
+} // end namespace llvm
+
+#endif // LLVM_PROFILEDATA_COVERAGESUMMARY_H
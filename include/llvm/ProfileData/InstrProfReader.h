@@ -225,6 +225,13 @@ public:
   }
 
   data_type ReadData(StringRef K, const unsigned char *D, offset_type N);
+
+  /// Read the hash and counts of the next record of a function's data, from
+  /// \c D up to \c End, and advance \c D past it. The counts refer to the
+  /// data. Return false if the data is corrupt.
+  bool ReadRecord(const unsigned char *&D, const unsigned char *End,
+                  uint64_t &Hash,
+                  ArrayRef<support::ulittle64_t> &Counts) const;
 };
 
 typedef OnDiskIterableChainedHashTable<InstrProfLookupTrait>
@@ -261,6 +268,19 @@ public:
   /// Fill Counts with the profile data for the given function name.
   std::error_code getFunctionCounts(StringRef FuncName, uint64_t FuncHash,
                                     std::vector<uint64_t> &Counts);
+  /// Set Counts to the profile data for the given function name, without
+  /// copying it. The counts remain valid as long as the reader.
+  std::error_code getFunctionCounts(StringRef FuncName, uint64_t FuncHash,
+                                    ArrayRef<support::ulittle64_t> &Counts);
+  /// Like the above, with the hash of FuncName computed beforehand by
+  /// getFunctionNameHash.
+  std::error_code getFunctionCounts(StringRef FuncName, uint64_t NameHash,
+                                    uint64_t FuncHash,
+                                    ArrayRef<support::ulittle64_t> &Counts);
+  /// Return the hash of a function name, by which the index is keyed.
+  uint64_t getFunctionNameHash(StringRef FuncName) {
+    return Index->getInfoObj().ComputeHash(FuncName);
+  }
   /// Return the maximum of all known function counts.
   uint64_t getMaximumFunctionCount() { return MaxFunctionCount; }
 
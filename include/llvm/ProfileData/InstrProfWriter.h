@@ -17,6 +17,7 @@
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ProfileData/InstrProf.h"
 #include "llvm/Support/DataTypes.h"
@@ -30,11 +31,24 @@ namespace llvm {
 class InstrProfWriter {
 public:
   typedef SmallDenseMap<uint64_t, std::vector<uint64_t>, 1> CounterData;
+
+  /// A function whose counter data is already encoded as in the indexed
+  /// profile: for each function hash, the hash, the number of counters and
+  /// the counters, as little-endian 64-bit integers.
+  struct EncodedFunction {
+    StringRef Name;
+    StringRef Data;
+  };
+
 private:
   StringMap<CounterData> FunctionData;
   uint64_t MaxFunctionCount;
+  /// Approximate number of bytes taken by FunctionData.
+  size_t DataSize;
+
+  friend class InstrProfSpillingWriter;
 public:
-  InstrProfWriter() : MaxFunctionCount(0) {}
+  InstrProfWriter() : MaxFunctionCount(0), DataSize(0) {}
 
   /// Add function counts for the given function. If there are already counts
   /// for this function and the hash and number of counts match, each counter is
@@ -42,8 +56,21 @@ public:
   std::error_code addFunctionCounts(StringRef FunctionName,
                                     uint64_t FunctionHash,
                                     ArrayRef<uint64_t> Counters);
+  /// Add the counts of all functions of \c IPW, which is left empty. Counts
+  /// that cannot be summed are reported through \c Warn, with the name and
+  /// hash of their function.
+  void mergeRecordsFromWriter(
+      InstrProfWriter &&IPW,
+      function_ref<void(StringRef, uint64_t, std::error_code)> Warn);
+  /// Return the approximate number of bytes taken by the counts so far.
+  size_t getDataSize() const { return DataSize; }
   /// Write the profile to \c OS
   void write(raw_fd_ostream &OS);
+  /// Write a profile of functions that are already encoded, e.g. in a
+  /// memory-mapped file, to \c OS.
+  static void writeEncoded(raw_fd_ostream &OS,
+                           ArrayRef<EncodedFunction> Functions,
+                           uint64_t MaxFunctionCount);
   /// Write the profile, returning the raw data. For testing.
   std::unique_ptr<MemoryBuffer> writeBuffer();
 
@@ -51,6 +78,45 @@ private:
   std::pair<uint64_t, uint64_t> writeImpl(raw_ostream &OS);
 };
 
+/// Writer for instrumentation based profile data, which keeps the counts in
+/// memory up to a limit. Beyond the limit, the counts are spilled to a
+/// temporary file, sorted by function name, and the spilled runs are merged
+/// when the profile is written.
+class InstrProfSpillingWriter {
+  InstrProfWriter Writer;
+  size_t MemoryLimit;
+  /// The temporary files, which are removed by the destructor.
+  std::vector<std::string> TempFiles;
+  /// The spilled runs, as indices into TempFiles.
+  std::vector<size_t> Runs;
+  /// The first error that occurred while spilling, reported by write.
+  std::error_code SpillError;
+
+  InstrProfSpillingWriter(const InstrProfSpillingWriter &) = delete;
+  InstrProfSpillingWriter &
+  operator=(const InstrProfSpillingWriter &) = delete;
+public:
+  InstrProfSpillingWriter(size_t MemoryLimit) : MemoryLimit(MemoryLimit) {}
+  ~InstrProfSpillingWriter();
+
+  /// Add function counts for the given function, as
+  /// InstrProfWriter::addFunctionCounts does. Counts from spilled runs are
+  /// only merged by write.
+  std::error_code addFunctionCounts(StringRef FunctionName,
+                                    uint64_t FunctionHash,
+                                    ArrayRef<uint64_t> Counters);
+  /// Write the profile to \c OS. Counts that cannot be summed are reported
+  /// through \c Warn, with the name of their function.
+  std::error_code write(raw_fd_ostream &OS,
+                        function_ref<void(StringRef, std::error_code)> Warn);
+
+private:
+  std::error_code createTempFile(int &FD);
+  std::error_code spill();
+  std::error_code mergeRuns(raw_ostream &OS, uint64_t &MaxFunctionCount,
+                            function_ref<void(StringRef, std::error_code)> Warn);
+};
+
 } // end namespace llvm
 
 #endif
@@ -0,0 +1,39 @@
+//===- LinkAllProfileData.h - Reference the profile readers -----*- C++ -*-===//
+//
+//                      The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This header file pulls the profile readers of libLLVMProfileData.a into
+// tools like opt and llvm-lto, so that plugins loaded with -load can use them
+// without linking their own copy of LLVM. It should only be used from a
+// tool's main program.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PROFILEDATA_LINKALLPROFILEDATA_H
+#define LLVM_PROFILEDATA_LINKALLPROFILEDATA_H
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/ProfileData/SampleProfReader.h"
+#include <cstdlib>
+
+namespace {
+  struct ForceProfileDataLinking {
+    ForceProfileDataLinking() {
+      // See ForceVMCoreLinking in llvm/LinkAllIR.h.
+      if (std::getenv("bar") != (char*) -1)
+        return;
+      (void)llvm::InstrProfReader::create("");
+      (void)llvm::IndexedInstrProfReader::create("");
+      (void)llvm::sampleprof::SampleProfileReader::create(
+          "", llvm::getGlobalContext());
+    }
+  } ForceProfileDataLinking;
+}
+
+#endif
@@ -90,6 +90,15 @@ public:
     /// peephole optimizations similar to the instruction combiner. These passes
     /// will be inserted after each instance of the instruction combiner pass.
     EP_Peephole,
+
+    /// EP_FullLinkTimeOptimizationEarly - This extension point allows adding
+    /// passes that see the merged module of a full LTO link, before any of
+    /// the link-time optimizations run.
+    EP_FullLinkTimeOptimizationEarly,
+
+    /// EP_FullLinkTimeOptimizationLast - This extension point allows adding
+    /// passes that run at the end of full LTO.
+    EP_FullLinkTimeOptimizationLast,
   };
 
   /// The Optimization Level - Specify the basic optimization level.
@@ -231,6 +231,7 @@ CoverageMapping::load(CoverageMappingReader &CoverageReader,
     Coverage->Functions.push_back(std::move(Function));
   }
 
+  Coverage->indexFunctionsByFile();
   return std::move(Coverage);
 }
 
@@ -398,6 +399,28 @@ static Optional<unsigned> findMainViewFileID(const FunctionRecord &Function) {
   return I;
 }
 
+void CoverageMapping::indexFunctionsByFile() {
+  for (unsigned I = 0, E = Functions.size(); I < E; ++I) {
+    const FunctionRecord &Function = Functions[I];
+    for (const auto &Filename : Function.Filenames) {
+      auto &FileFunctions = FunctionsByFile[Filename];
+      // A file can occur several times in a function's filenames.
+      if (!FileFunctions.empty() && FileFunctions.back() == I)
+        continue;
+      if (findMainViewFileID(Filename, Function))
+        FileFunctions.push_back(I);
+    }
+  }
+}
+
+ArrayRef<unsigned>
+CoverageMapping::getFunctionsInFile(StringRef Filename) const {
+  auto I = FunctionsByFile.find(Filename);
+  if (I == FunctionsByFile.end())
+    return None;
+  return I->second;
+}
+
 /// Sort a nested sequence of regions from a single file.
 template <class It> static void sortNestedRegions(It First, It Last) {
   std::sort(First, Last,
@@ -417,10 +440,9 @@ CoverageData CoverageMapping::getCoverageForFile(StringRef Filename) {
   CoverageData FileCoverage(Filename);
   std::vector<coverage::CountedRegion> Regions;
 
-  for (const auto &Function : Functions) {
+  for (unsigned I : getFunctionsInFile(Filename)) {
+    const FunctionRecord &Function = Functions[I];
     auto MainFileID = findMainViewFileID(Filename, Function);
-    if (!MainFileID)
-      continue;
     auto FileIDs = gatherFileIDs(Filename, Function);
     for (const auto &CR : Function.CountedRegions)
       if (FileIDs.test(CR.FileID)) {
@@ -440,10 +462,9 @@ CoverageData CoverageMapping::getCoverageForFile(StringRef Filename) {
 std::vector<const FunctionRecord *>
 CoverageMapping::getInstantiations(StringRef Filename) {
   FunctionInstantiationSetCollector InstantiationSetCollector;
-  for (const auto &Function : Functions) {
+  for (unsigned I : getFunctionsInFile(Filename)) {
+    const FunctionRecord &Function = Functions[I];
     auto MainFileID = findMainViewFileID(Filename, Function);
-    if (!MainFileID)
-      continue;
     InstantiationSetCollector.insert(Function, *MainFileID);
   }
 
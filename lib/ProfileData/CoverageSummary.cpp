@@ -0,0 +1,249 @@
+//=-- CoverageSummary.cpp - Per-function coverage summaries -------*- C++ -*-=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains support for writing and reading per-function coverage
+// summaries.
+//
+// A summary is a header of two little-endian 64-bit integers (the magic
+// number and the version), followed by one record per function:
+//
+//   uint64 FunctionHash, uint64 ExecutionCount,
+//   uint32 NameSize, char Name[NameSize],
+//   uint32 NumFilenames, { uint32 Size, char Filename[Size] }[NumFilenames],
+//   uint32 NumRegions,
+//   { uint32 FileID, LineStart, ColumnStart, LineEnd, ColumnEnd, Depth,
+//     uint64 ExecutionCount }[NumRegions]
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ProfileData/CoverageSummary.h"
+#include "llvm/ProfileData/CoverageMapping.h"
+#include "llvm/ProfileData/CoverageMappingReader.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace coverage;
+
+/// \brief Compute the code regions of a function, ordered by file and start
+/// location, with their nesting depths.
+static std::error_code summarizeFunction(const CoverageMappingRecord &Record,
+                                         const CounterMappingContext &Ctx,
+                                         std::vector<RegionSummary> &Regions) {
+  Regions.clear();
+  for (const auto &Region : Record.MappingRegions) {
+    if (Region.Kind != CounterMappingRegion::CodeRegion)
+      continue;
+    ErrorOr<int64_t> ExecutionCount = Ctx.evaluate(Region.Count);
+    if (std::error_code EC = ExecutionCount.getError())
+      return EC;
+    Regions.push_back({Region.FileID, Region.LineStart, Region.ColumnStart,
+                       Region.LineEnd, Region.ColumnEnd, 0,
+                       uint64_t(*ExecutionCount)});
+  }
+
+  // Outer regions come before the regions they contain, so a region's depth
+  // is the number of regions on the stack that still contain it.
+  std::stable_sort(Regions.begin(), Regions.end(),
+                   [](const RegionSummary &LHS, const RegionSummary &RHS) {
+    return std::tie(LHS.FileID, LHS.LineStart, LHS.ColumnStart, RHS.LineEnd,
+                    RHS.ColumnEnd) < std::tie(RHS.FileID, RHS.LineStart,
+                                              RHS.ColumnStart, LHS.LineEnd,
+                                              LHS.ColumnEnd);
+  });
+  std::vector<const RegionSummary *> Enclosing;
+  for (auto &Region : Regions) {
+    while (!Enclosing.empty() &&
+           (Enclosing.back()->FileID != Region.FileID ||
+            std::tie(Enclosing.back()->LineEnd, Enclosing.back()->ColumnEnd) <
+                std::tie(Region.LineEnd, Region.ColumnEnd)))
+      Enclosing.pop_back();
+    Region.Depth = Enclosing.size();
+    Enclosing.push_back(&Region);
+  }
+  return std::error_code();
+}
+
+static void writeString(support::endian::Writer<support::little> &LE,
+                        StringRef Str) {
+  LE.write<uint32_t>(Str.size());
+  LE.OS << Str;
+}
+
+std::error_code
+coverage::writeCoverageSummary(CoverageMappingReader &CoverageReader,
+                               IndexedInstrProfReader &ProfileReader,
+                               raw_ostream &OS) {
+  support::endian::Writer<support::little> LE(OS);
+  LE.write<uint64_t>(CoverageSummaryMagic);
+  LE.write<uint64_t>(CoverageSummaryVersion);
+
+  std::vector<uint64_t> Counts;
+  std::vector<RegionSummary> Regions;
+  for (const auto &Record : CoverageReader) {
+    Counts.clear();
+    if (std::error_code EC = ProfileReader.getFunctionCounts(
+            Record.FunctionName, Record.FunctionHash, Counts)) {
+      if (EC == instrprof_error::hash_mismatch)
+        continue;
+      else if (EC != instrprof_error::unknown_function)
+        return EC;
+      Counts.assign(Record.MappingRegions.size(), 0);
+    }
+    CounterMappingContext Ctx(Record.Expressions);
+    Ctx.setCounts(Counts);
+    if (summarizeFunction(Record, Ctx, Regions))
+      continue;
+
+    LE.write<uint64_t>(Record.FunctionHash);
+    // Like FunctionRecord, the function's count is that of its first region.
+    uint64_t ExecutionCount = 0;
+    if (!Record.MappingRegions.empty()) {
+      ErrorOr<int64_t> Count = Ctx.evaluate(Record.MappingRegions[0].Count);
+      if (Count)
+        ExecutionCount = *Count;
+    }
+    LE.write<uint64_t>(ExecutionCount);
+    writeString(LE, Record.FunctionName);
+    LE.write<uint32_t>(Record.Filenames.size());
+    for (StringRef Filename : Record.Filenames)
+      writeString(LE, Filename);
+    LE.write<uint32_t>(Regions.size());
+    for (const auto &Region : Regions) {
+      LE.write<uint32_t>(Region.FileID);
+      LE.write<uint32_t>(Region.LineStart);
+      LE.write<uint32_t>(Region.ColumnStart);
+      LE.write<uint32_t>(Region.LineEnd);
+      LE.write<uint32_t>(Region.ColumnEnd);
+      LE.write<uint32_t>(Region.Depth);
+      LE.write<uint64_t>(Region.ExecutionCount);
+    }
+  }
+  return std::error_code();
+}
+
+std::error_code coverage::writeCoverageSummary(StringRef ObjectFilename,
+                                               StringRef ProfileFilename,
+                                               raw_ostream &OS,
+                                               StringRef Arch) {
+  auto CounterMappingBuff = MemoryBuffer::getFileOrSTDIN(ObjectFilename);
+  if (std::error_code EC = CounterMappingBuff.getError())
+    return EC;
+  auto CoverageReaderOrErr =
+      BinaryCoverageReader::create(CounterMappingBuff.get(), Arch);
+  if (std::error_code EC = CoverageReaderOrErr.getError())
+    return EC;
+  auto ProfileReaderOrErr = IndexedInstrProfReader::create(ProfileFilename);
+  if (std::error_code EC = ProfileReaderOrErr.getError())
+    return EC;
+  return writeCoverageSummary(*CoverageReaderOrErr.get(),
+                              *ProfileReaderOrErr.get(), OS);
+}
+
+CoverageSummaryReader::CoverageSummaryReader(
+    std::unique_ptr<MemoryBuffer> Buffer)
+    : Buffer(std::move(Buffer)) {
+  Cur = this->Buffer->getBufferStart() + 2 * sizeof(uint64_t);
+}
+
+ErrorOr<std::unique_ptr<CoverageSummaryReader>>
+CoverageSummaryReader::create(std::unique_ptr<MemoryBuffer> Buffer) {
+  using namespace support;
+  if (Buffer->getBufferSize() < 2 * sizeof(uint64_t))
+    return coveragemap_error::truncated;
+  const char *Start = Buffer->getBufferStart();
+  if (endian::read<uint64_t, little, unaligned>(Start) != CoverageSummaryMagic)
+    return coveragemap_error::malformed;
+  if (endian::read<uint64_t, little, unaligned>(Start + sizeof(uint64_t)) !=
+      CoverageSummaryVersion)
+    return coveragemap_error::unsupported_version;
+  return std::unique_ptr<CoverageSummaryReader>(
+      new CoverageSummaryReader(std::move(Buffer)));
+}
+
+ErrorOr<std::unique_ptr<CoverageSummaryReader>>
+CoverageSummaryReader::create(StringRef Path) {
+  auto BufferOrErr =
+      MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = BufferOrErr.getError())
+    return EC;
+  return create(std::move(BufferOrErr.get()));
+}
+
+namespace {
+/// \brief Bounds-checked reads from a summary buffer.
+class SummaryCursor {
+  const char *&Cur;
+  const char *End;
+
+public:
+  SummaryCursor(const char *&Cur, const char *End) : Cur(Cur), End(End) {}
+
+  template <typename T> bool read(T &Value) {
+    if (size_t(End - Cur) < sizeof(T))
+      return false;
+    Value = support::endian::readNext<T, support::little, support::unaligned>(
+        Cur);
+    return true;
+  }
+
+  bool read(StringRef &Str) {
+    uint32_t Size;
+    if (!read(Size) || size_t(End - Cur) < Size)
+      return false;
+    Str = StringRef(Cur, Size);
+    Cur += Size;
+    return true;
+  }
+};
+}
+
+std::error_code
+CoverageSummaryReader::readNextFunction(FunctionSummary &Function) {
+  const char *End = Buffer->getBufferEnd();
+  if (Cur == End)
+    return coveragemap_error::eof;
+
+  SummaryCursor C(Cur, End);
+  uint32_t NumFilenames, NumRegions;
+  if (!C.read(Function.FunctionHash) || !C.read(Function.ExecutionCount) ||
+      !C.read(Function.Name) || !C.read(NumFilenames))
+    return coveragemap_error::truncated;
+  Function.Filenames.resize(NumFilenames);
+  for (StringRef &Filename : Function.Filenames)
+    if (!C.read(Filename))
+      return coveragemap_error::truncated;
+  if (!C.read(NumRegions))
+    return coveragemap_error::truncated;
+  if (size_t(End - Cur) / (6 * sizeof(uint32_t) + sizeof(uint64_t)) <
+      NumRegions)
+    return coveragemap_error::truncated;
+  Function.Regions.resize(NumRegions);
+  for (RegionSummary &Region : Function.Regions) {
+    uint32_t FileID, LineStart, ColumnStart, LineEnd, ColumnEnd, Depth;
+    C.read(FileID);
+    C.read(LineStart);
+    C.read(ColumnStart);
+    C.read(LineEnd);
+    C.read(ColumnEnd);
+    C.read(Depth);
+    C.read(Region.ExecutionCount);
+    if (FileID >= NumFilenames)
+      return coveragemap_error::malformed;
+    Region.FileID = FileID;
+    Region.LineStart = LineStart;
+    Region.ColumnStart = ColumnStart;
+    Region.LineEnd = LineEnd;
+    Region.ColumnEnd = ColumnEnd;
+    Region.Depth = Depth;
+  }
+  return coveragemap_error::success;
+}
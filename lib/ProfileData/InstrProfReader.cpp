@@ -67,8 +67,12 @@ InstrProfReader::create(std::unique_ptr<MemoryBuffer> Buffer) {
 
 ErrorOr<std::unique_ptr<IndexedInstrProfReader>>
 IndexedInstrProfReader::create(std::string Path) {
-  // Set up the buffer to read.
-  auto BufferOrError = setupMemoryBuffer(Path);
+  // Set up the buffer to read. The indexed format needs no null terminator,
+  // which lets the file be mapped rather than read, whatever its size.
+  auto BufferOrError =
+      Path == "-" ? setupMemoryBuffer(Path)
+                  : MemoryBuffer::getFile(Path, -1,
+                                          /*RequiresNullTerminator=*/false);
   if (std::error_code EC = BufferOrError.getError())
     return EC;
   return IndexedInstrProfReader::create(std::move(BufferOrError.get()));
@@ -310,36 +314,46 @@ data_type InstrProfLookupTrait::ReadData(StringRef K, const unsigned char *D,
     return data_type();
 
   DataBuffer.clear();
-  uint64_t NumCounts;
-  uint64_t NumEntries = N / sizeof(uint64_t);
-  std::vector<uint64_t> CounterBuffer;
-  for (uint64_t I = 0; I < NumEntries; I += NumCounts) {
-    using namespace support;
-    // The function hash comes first.
-    uint64_t Hash = endian::readNext<uint64_t, little, unaligned>(D);
-
-    if (++I >= NumEntries)
+  const unsigned char *End = D + N;
+  while (D < End) {
+    uint64_t Hash;
+    ArrayRef<support::ulittle64_t> Counts;
+    if (!ReadRecord(D, End, Hash, Counts))
       return data_type();
+    DataBuffer.push_back(InstrProfRecord(
+        K, Hash, std::vector<uint64_t>(Counts.begin(), Counts.end())));
+  }
+  return DataBuffer;
+}
 
-    // In v1, we have at least one count.
-    // Later, we have the number of counts.
-    NumCounts = (1 == FormatVersion)
-                    ? NumEntries - I
-                    : endian::readNext<uint64_t, little, unaligned>(D);
-    if (1 != FormatVersion)
-      ++I;
-
-    // If we have more counts than data, this is bogus.
-    if (I + NumCounts > NumEntries)
-      return data_type();
+bool InstrProfLookupTrait::ReadRecord(
+    const unsigned char *&D, const unsigned char *End, uint64_t &Hash,
+    ArrayRef<support::ulittle64_t> &Counts) const {
+  using namespace support;
+  uint64_t NumEntries = (End - D) / sizeof(uint64_t);
+  // The function hash comes first, and is followed by at least one entry.
+  if (NumEntries < 2)
+    return false;
+  Hash = endian::readNext<uint64_t, little, unaligned>(D);
+  --NumEntries;
+
+  // In v1, we have at least one count.
+  // Later, we have the number of counts.
+  uint64_t NumCounts = NumEntries;
+  if (1 != FormatVersion) {
+    NumCounts = endian::readNext<uint64_t, little, unaligned>(D);
+    --NumEntries;
+  }
 
-    CounterBuffer.clear();
-    for (unsigned J = 0; J < NumCounts; ++J)
-      CounterBuffer.push_back(endian::readNext<uint64_t, little, unaligned>(D));
+  // If we have more counts than data, this is bogus.
+  if (NumCounts > NumEntries)
+    return false;
 
-    DataBuffer.push_back(InstrProfRecord(K, Hash, std::move(CounterBuffer)));
-  }
-  return DataBuffer;
+  // The counts are read in place. They are not aligned, since the keys of
+  // the hash table are not padded.
+  Counts = makeArrayRef(reinterpret_cast<const ulittle64_t *>(D), NumCounts);
+  D += NumCounts * sizeof(uint64_t);
+  return true;
 }
 
 bool IndexedInstrProfReader::hasFormat(const MemoryBuffer &DataBuffer) {
@@ -392,19 +406,43 @@ std::error_code IndexedInstrProfReader::readHeader() {
 
 std::error_code IndexedInstrProfReader::getFunctionCounts(
     StringRef FuncName, uint64_t FuncHash, std::vector<uint64_t> &Counts) {
-  auto Iter = Index->find(FuncName);
+  ArrayRef<support::ulittle64_t> Data;
+  if (std::error_code EC = getFunctionCounts(FuncName, FuncHash, Data))
+    return EC;
+  Counts.assign(Data.begin(), Data.end());
+  return success();
+}
+
+std::error_code IndexedInstrProfReader::getFunctionCounts(
+    StringRef FuncName, uint64_t FuncHash,
+    ArrayRef<support::ulittle64_t> &Counts) {
+  return getFunctionCounts(FuncName, getFunctionNameHash(FuncName), FuncHash,
+                           Counts);
+}
+
+std::error_code IndexedInstrProfReader::getFunctionCounts(
+    StringRef FuncName, uint64_t NameHash, uint64_t FuncHash,
+    ArrayRef<support::ulittle64_t> &Counts) {
+  auto Iter = Index->find_hashed(FuncName, NameHash);
   if (Iter == Index->end())
     return error(instrprof_error::unknown_function);
 
-  // Found it. Look for counters with the right hash.
-  ArrayRef<InstrProfRecord> Data = (*Iter);
-  if (Data.empty())
+  // Found it. Look for counters with the right hash, without decoding the
+  // records of the function into InstrProfRecords.
+  const unsigned char *D = Iter.getDataPtr();
+  offset_type N = Iter.getDataLen();
+  if (N == 0 || N % sizeof(uint64_t))
     return error(instrprof_error::malformed);
 
-  for (unsigned I = 0, E = Data.size(); I < E; ++I) {
-    // Check for a match and fill the vector if there is one.
-    if (Data[I].Hash == FuncHash) {
-      Counts = Data[I].Counts;
+  const InstrProfLookupTrait &Trait = Index->getInfoObj();
+  for (const unsigned char *End = D + N; D < End;) {
+    uint64_t Hash;
+    ArrayRef<support::ulittle64_t> Data;
+    if (!Trait.ReadRecord(D, End, Hash, Data))
+      return error(instrprof_error::malformed);
+    // Check for a match and return a view of the counters if there is one.
+    if (Hash == FuncHash) {
+      Counts = Data;
       return success();
     }
   }
@@ -16,10 +16,38 @@
 #include "InstrProfIndexed.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/OnDiskHashTable.h"
+#include <algorithm>
+#include <queue>
 
 using namespace llvm;
 
+typedef InstrProfWriter::CounterData CounterData;
+
+/// Return the size of the encoding of \c V.
+static uint64_t getEncodedSize(const CounterData &V) {
+  uint64_t M = 0;
+  for (const auto &Counts : V)
+    M += (2 + Counts.second.size()) * sizeof(uint64_t);
+  return M;
+}
+
+/// Encode \c V as in the indexed profile: for each function hash, the hash,
+/// the number of counters and the counters.
+static void encodeCounterData(raw_ostream &Out, const CounterData &V) {
+  using namespace llvm::support;
+  endian::Writer<little> LE(Out);
+
+  for (const auto &Counts : V) {
+    LE.write<uint64_t>(Counts.first);
+    LE.write<uint64_t>(Counts.second.size());
+    for (uint64_t I : Counts.second)
+      LE.write<uint64_t>(I);
+  }
+}
+
 namespace {
 class InstrProfRecordTrait {
 public:
@@ -44,9 +72,7 @@ public:
     offset_type N = K.size();
     LE.write<offset_type>(N);
 
-    offset_type M = 0;
-    for (const auto &Counts : *V)
-      M += (2 + Counts.second.size()) * sizeof(uint64_t);
+    offset_type M = getEncodedSize(*V);
     LE.write<offset_type>(M);
 
     return std::make_pair(N, M);
@@ -58,29 +84,106 @@ public:
 
   static void EmitData(raw_ostream &Out, key_type_ref, data_type_ref V,
                        offset_type) {
+    encodeCounterData(Out, *V);
+  }
+};
+
+/// Trait for functions whose data is already encoded.
+class EncodedRecordTrait {
+public:
+  typedef StringRef key_type;
+  typedef StringRef key_type_ref;
+
+  typedef StringRef data_type;
+  typedef StringRef data_type_ref;
+
+  typedef uint64_t hash_value_type;
+  typedef uint64_t offset_type;
+
+  static hash_value_type ComputeHash(key_type_ref K) {
+    return IndexedInstrProf::ComputeHash(IndexedInstrProf::HashType, K);
+  }
+
+  static std::pair<offset_type, offset_type>
+  EmitKeyDataLength(raw_ostream &Out, key_type_ref K, data_type_ref V) {
     using namespace llvm::support;
     endian::Writer<little> LE(Out);
 
-    for (const auto &Counts : *V) {
-      LE.write<uint64_t>(Counts.first);
-      LE.write<uint64_t>(Counts.second.size());
-      for (uint64_t I : Counts.second)
-        LE.write<uint64_t>(I);
+    offset_type N = K.size();
+    LE.write<offset_type>(N);
+    offset_type M = V.size();
+    LE.write<offset_type>(M);
+    return std::make_pair(N, M);
+  }
+
+  static void EmitKey(raw_ostream &Out, key_type_ref K, offset_type N) {
+    Out.write(K.data(), N);
+  }
+
+  static void EmitData(raw_ostream &Out, key_type_ref, data_type_ref V,
+                       offset_type M) {
+    Out.write(V.data(), M);
+  }
+};
+
+/// A run of functions spilled by InstrProfSpillingWriter, sorted by name.
+/// Each function is stored as the length of its name, its name, the length
+/// of its data, and its data, encoded as in the indexed profile.
+class SpilledRun {
+  const unsigned char *Cur;
+  const unsigned char *End;
+
+public:
+  StringRef Name;
+  StringRef Data;
+
+  SpilledRun(const MemoryBuffer &Buffer)
+      : Cur((const unsigned char *)Buffer.getBufferStart()),
+        End((const unsigned char *)Buffer.getBufferEnd()) {}
+
+  /// Read the next function into Name and Data.
+  std::error_code next() {
+    using namespace llvm::support;
+    if (Cur == End)
+      return instrprof_error::eof;
+    StringRef *Fields[] = {&Name, &Data};
+    for (StringRef *Field : Fields) {
+      if (uint64_t(End - Cur) < sizeof(uint64_t))
+        return instrprof_error::truncated;
+      uint64_t Len = endian::readNext<uint64_t, little, unaligned>(Cur);
+      if (uint64_t(End - Cur) < Len)
+        return instrprof_error::truncated;
+      *Field = StringRef((const char *)Cur, Len);
+      Cur += Len;
     }
+    return instrprof_error::success;
   }
 };
 }
 
+/// Approximate memory taken by a function of FunctionData.
+static size_t getNameSize(StringRef FunctionName) {
+  return sizeof(StringMapEntry<CounterData>) + FunctionName.size() + 1;
+}
+
+/// Approximate memory taken by the counters of one hash of a function.
+static size_t getCountsSize(ArrayRef<uint64_t> Counters) {
+  return sizeof(CounterData::value_type) + Counters.size() * sizeof(uint64_t);
+}
+
 std::error_code
 InstrProfWriter::addFunctionCounts(StringRef FunctionName,
                                    uint64_t FunctionHash,
                                    ArrayRef<uint64_t> Counters) {
   auto &CounterData = FunctionData[FunctionName];
+  if (CounterData.empty())
+    DataSize += getNameSize(FunctionName);
 
   auto Where = CounterData.find(FunctionHash);
   if (Where == CounterData.end()) {
     // We've never seen a function with this name and hash, add it.
     CounterData[FunctionHash] = Counters;
+    DataSize += getCountsSize(Counters);
     // We keep track of the max function count as we go for simplicity.
     if (Counters[0] > MaxFunctionCount)
       MaxFunctionCount = Counters[0];
@@ -106,13 +209,41 @@ InstrProfWriter::addFunctionCounts(StringRef FunctionName,
   return instrprof_error::success;
 }
 
-std::pair<uint64_t, uint64_t> InstrProfWriter::writeImpl(raw_ostream &OS) {
-  OnDiskChainedHashTableGenerator<InstrProfRecordTrait> Generator;
-
-  // Populate the hash table generator.
-  for (const auto &I : FunctionData)
-    Generator.insert(I.getKey(), &I.getValue());
+void InstrProfWriter::mergeRecordsFromWriter(
+    InstrProfWriter &&IPW,
+    function_ref<void(StringRef, uint64_t, std::error_code)> Warn) {
+  for (auto &I : IPW.FunctionData) {
+    auto &CounterData = FunctionData[I.getKey()];
+    if (CounterData.empty()) {
+      // Functions we haven't seen yet are taken over as they are, which is
+      // the common case when merging writers that hold disjoint functions.
+      CounterData = std::move(I.getValue());
+      DataSize += getNameSize(I.getKey());
+      for (const auto &Counts : CounterData) {
+        DataSize += getCountsSize(Counts.second);
+        if (Counts.second[0] > MaxFunctionCount)
+          MaxFunctionCount = Counts.second[0];
+      }
+      continue;
+    }
+    // The max function count of IPW may come from records that are dropped
+    // here, so it is only updated from the records that are kept.
+    for (const auto &Counts : I.getValue())
+      if (std::error_code EC =
+              addFunctionCounts(I.getKey(), Counts.first, Counts.second))
+        Warn(I.getKey(), Counts.first, EC);
+  }
+  IPW.FunctionData.clear();
+  IPW.MaxFunctionCount = 0;
+  IPW.DataSize = 0;
+}
 
+/// Write the header and the hash table of an indexed profile. Return the
+/// offset of the field that holds the start of the hash table, and that start.
+template <typename Trait>
+static std::pair<uint64_t, uint64_t>
+writeIndexed(raw_ostream &OS, OnDiskChainedHashTableGenerator<Trait> &Generator,
+             uint64_t MaxFunctionCount) {
   using namespace llvm::support;
   endian::Writer<little> LE(OS);
 
@@ -131,16 +262,37 @@ std::pair<uint64_t, uint64_t> InstrProfWriter::writeImpl(raw_ostream &OS) {
   return std::make_pair(HashTableStartLoc, HashTableStart);
 }
 
-void InstrProfWriter::write(raw_fd_ostream &OS) {
-  // Write the hash table.
-  auto TableStart = writeImpl(OS);
-
-  // Go back and fill in the hash table start.
+/// Go back and fill in the hash table start.
+static void patchHashTableStart(raw_fd_ostream &OS,
+                                std::pair<uint64_t, uint64_t> TableStart) {
   using namespace support;
   OS.seek(TableStart.first);
   endian::Writer<little>(OS).write<uint64_t>(TableStart.second);
 }
 
+std::pair<uint64_t, uint64_t> InstrProfWriter::writeImpl(raw_ostream &OS) {
+  OnDiskChainedHashTableGenerator<InstrProfRecordTrait> Generator;
+
+  // Populate the hash table generator.
+  for (const auto &I : FunctionData)
+    Generator.insert(I.getKey(), &I.getValue());
+
+  return writeIndexed(OS, Generator, MaxFunctionCount);
+}
+
+void InstrProfWriter::write(raw_fd_ostream &OS) {
+  patchHashTableStart(OS, writeImpl(OS));
+}
+
+void InstrProfWriter::writeEncoded(raw_fd_ostream &OS,
+                                   ArrayRef<EncodedFunction> Functions,
+                                   uint64_t MaxFunctionCount) {
+  OnDiskChainedHashTableGenerator<EncodedRecordTrait> Generator;
+  for (const EncodedFunction &F : Functions)
+    Generator.insert(F.Name, F.Data);
+  patchHashTableStart(OS, writeIndexed(OS, Generator, MaxFunctionCount));
+}
+
 std::unique_ptr<MemoryBuffer> InstrProfWriter::writeBuffer() {
   std::string Data;
   llvm::raw_string_ostream OS(Data);
@@ -157,3 +309,215 @@ std::unique_ptr<MemoryBuffer> InstrProfWriter::writeBuffer() {
   // Return this in an aligned memory buffer.
   return MemoryBuffer::getMemBufferCopy(Data);
 }
+
+InstrProfSpillingWriter::~InstrProfSpillingWriter() {
+  for (const std::string &Path : TempFiles)
+    sys::fs::remove(Path);
+}
+
+std::error_code
+InstrProfSpillingWriter::addFunctionCounts(StringRef FunctionName,
+                                           uint64_t FunctionHash,
+                                           ArrayRef<uint64_t> Counters) {
+  std::error_code EC =
+      Writer.addFunctionCounts(FunctionName, FunctionHash, Counters);
+  // If spilling failed, keep the counts in memory; write reports the error.
+  if (Writer.getDataSize() > MemoryLimit && !SpillError)
+    SpillError = spill();
+  return EC;
+}
+
+std::error_code InstrProfSpillingWriter::createTempFile(int &FD) {
+  SmallString<128> Path;
+  if (std::error_code EC =
+          sys::fs::createTemporaryFile("profdata-spill", "run", FD, Path))
+    return EC;
+  TempFiles.push_back(Path.str());
+  return instrprof_error::success;
+}
+
+std::error_code InstrProfSpillingWriter::spill() {
+  int FD;
+  if (std::error_code EC = createTempFile(FD))
+    return EC;
+
+  std::vector<const StringMapEntry<CounterData> *> Functions;
+  Functions.reserve(Writer.FunctionData.size());
+  for (const auto &I : Writer.FunctionData)
+    Functions.push_back(&I);
+  std::sort(Functions.begin(), Functions.end(),
+            [](const StringMapEntry<CounterData> *A,
+               const StringMapEntry<CounterData> *B) {
+              return A->getKey() < B->getKey();
+            });
+
+  raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  using namespace llvm::support;
+  endian::Writer<little> LE(OS);
+  for (const auto *F : Functions) {
+    LE.write<uint64_t>(F->getKey().size());
+    OS << F->getKey();
+    LE.write<uint64_t>(getEncodedSize(F->getValue()));
+    encodeCounterData(OS, F->getValue());
+  }
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    return make_error_code(errc::io_error);
+  }
+
+  Runs.push_back(TempFiles.size() - 1);
+  Writer.FunctionData.clear();
+  Writer.DataSize = 0;
+  return instrprof_error::success;
+}
+
+/// Add the counters encoded in \c Data to \c Counters, like
+/// InstrProfWriter::addFunctionCounts does.
+static std::error_code
+mergeEncodedCounters(StringRef Name, StringRef Data, CounterData &Counters,
+                     function_ref<void(StringRef, std::error_code)> Warn) {
+  using namespace llvm::support;
+  const unsigned char *D = (const unsigned char *)Data.begin();
+  const unsigned char *End = (const unsigned char *)Data.end();
+  while (D != End) {
+    if (uint64_t(End - D) < 2 * sizeof(uint64_t))
+      return instrprof_error::truncated;
+    uint64_t Hash = endian::readNext<uint64_t, little, unaligned>(D);
+    uint64_t NumCounts = endian::readNext<uint64_t, little, unaligned>(D);
+    if (uint64_t(End - D) / sizeof(uint64_t) < NumCounts)
+      return instrprof_error::truncated;
+    const unsigned char *CountsEnd = D + NumCounts * sizeof(uint64_t);
+
+    auto Where = Counters.find(Hash);
+    if (Where == Counters.end()) {
+      std::vector<uint64_t> &New = Counters[Hash];
+      New.reserve(NumCounts);
+      while (D != CountsEnd)
+        New.push_back(endian::readNext<uint64_t, little, unaligned>(D));
+      continue;
+    }
+
+    std::vector<uint64_t> &Found = Where->second;
+    if (Found.size() != NumCounts) {
+      Warn(Name, instrprof_error::count_mismatch);
+      D = CountsEnd;
+      continue;
+    }
+    for (uint64_t &C : Found) {
+      uint64_t N = endian::readNext<uint64_t, little, unaligned>(D);
+      if (C + N < C) {
+        Warn(Name, instrprof_error::counter_overflow);
+        break;
+      }
+      C += N;
+    }
+    D = CountsEnd;
+  }
+  return instrprof_error::success;
+}
+
+std::error_code InstrProfSpillingWriter::mergeRuns(
+    raw_ostream &OS, uint64_t &MaxFunctionCount,
+    function_ref<void(StringRef, std::error_code)> Warn) {
+  std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+  std::vector<SpilledRun> Cursors;
+  for (size_t Run : Runs) {
+    auto BufferOrErr = MemoryBuffer::getFile(TempFiles[Run], -1,
+                                             /*RequiresNullTerminator=*/false);
+    if (std::error_code EC = BufferOrErr.getError())
+      return EC;
+    Buffers.push_back(std::move(BufferOrErr.get()));
+    Cursors.push_back(SpilledRun(*Buffers.back()));
+  }
+
+  // Merge the runs, taking the functions of a given name in the order of the
+  // runs, which is the order in which they were added.
+  auto Greater = [&](size_t A, size_t B) {
+    int Cmp = Cursors[A].Name.compare(Cursors[B].Name);
+    return Cmp > 0 || (Cmp == 0 && A > B);
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(Greater)> Heap(
+      Greater);
+  auto Advance = [&](size_t I) -> std::error_code {
+    std::error_code EC = Cursors[I].next();
+    if (EC == instrprof_error::eof)
+      return instrprof_error::success;
+    if (!EC)
+      Heap.push(I);
+    return EC;
+  };
+  for (size_t I = 0, E = Cursors.size(); I < E; ++I)
+    if (std::error_code EC = Advance(I))
+      return EC;
+
+  using namespace llvm::support;
+  endian::Writer<little> LE(OS);
+  MaxFunctionCount = 0;
+  while (!Heap.empty()) {
+    StringRef Name = Cursors[Heap.top()].Name;
+    CounterData Counters;
+    while (!Heap.empty() && Cursors[Heap.top()].Name == Name) {
+      size_t I = Heap.top();
+      Heap.pop();
+      if (std::error_code EC =
+              mergeEncodedCounters(Name, Cursors[I].Data, Counters, Warn))
+        return EC;
+      if (std::error_code EC = Advance(I))
+        return EC;
+    }
+
+    for (const auto &Counts : Counters)
+      if (!Counts.second.empty())
+        MaxFunctionCount = std::max(MaxFunctionCount, Counts.second[0]);
+    LE.write<uint64_t>(Name.size());
+    OS << Name;
+    LE.write<uint64_t>(getEncodedSize(Counters));
+    encodeCounterData(OS, Counters);
+  }
+  return instrprof_error::success;
+}
+
+std::error_code InstrProfSpillingWriter::write(
+    raw_fd_ostream &OS, function_ref<void(StringRef, std::error_code)> Warn) {
+  if (SpillError)
+    return SpillError;
+  if (Runs.empty()) {
+    Writer.write(OS);
+    return instrprof_error::success;
+  }
+  if (!Writer.FunctionData.empty())
+    if (std::error_code EC = spill())
+      return EC;
+
+  // Merge the runs into one more run, which is then indexed in place.
+  int FD;
+  if (std::error_code EC = createTempFile(FD))
+    return EC;
+  uint64_t MaxFunctionCount;
+  {
+    raw_fd_ostream Merged(FD, /*shouldClose=*/true);
+    if (std::error_code EC = mergeRuns(Merged, MaxFunctionCount, Warn))
+      return EC;
+    Merged.close();
+    if (Merged.has_error()) {
+      Merged.clear_error();
+      return make_error_code(errc::io_error);
+    }
+  }
+
+  auto BufferOrErr = MemoryBuffer::getFile(TempFiles.back(), -1,
+                                           /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = BufferOrErr.getError())
+    return EC;
+  std::vector<InstrProfWriter::EncodedFunction> Functions;
+  SpilledRun Run(*BufferOrErr.get());
+  std::error_code EC;
+  while (!(EC = Run.next()))
+    Functions.push_back({Run.Name, Run.Data});
+  if (EC != instrprof_error::eof)
+    return EC;
+
+  InstrProfWriter::writeEncoded(OS, Functions, MaxFunctionCount);
+  return instrprof_error::success;
+}
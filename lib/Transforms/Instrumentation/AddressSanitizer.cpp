@@ -18,6 +18,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
@@ -27,6 +28,7 @@
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/DataLayout.h"
@@ -197,6 +199,16 @@ static cl::opt<bool> ClOpt("asan-opt", cl::desc("Optimize instrumentation"),
 static cl::opt<bool> ClOptSameTemp(
     "asan-opt-same-temp", cl::desc("Instrument the same temp just once"),
     cl::Hidden, cl::init(true));
+static cl::opt<bool> ClOptDominated(
+    "asan-opt-dominated",
+    cl::desc("Don't instrument accesses dominated by an instrumented access to "
+             "the same address, unless memory may be freed in between"),
+    cl::Hidden, cl::init(true));
+static cl::opt<unsigned> ClOptDominatedMaxCandidates(
+    "asan-opt-dominated-max-candidates",
+    cl::desc("Maximum number of instrumented accesses to an address that are "
+             "tried as the dominating access of a later access"),
+    cl::Hidden, cl::init(8));
 static cl::opt<bool> ClOptGlobals("asan-opt-globals",
                                   cl::desc("Don't instrument scalar globals"),
                                   cl::Hidden, cl::init(true));
@@ -237,6 +249,8 @@ STATISTIC(NumOptimizedAccessesToGlobalVar,
           "Number of optimized accesses to global vars");
 STATISTIC(NumOptimizedAccessesToStackVar,
           "Number of optimized accesses to stack vars");
+STATISTIC(NumOptimizedDominatedAccesses,
+          "Number of optimized accesses dominated by a checked access");
 
 namespace {
 /// Frontend-provided metadata for source location.
@@ -446,6 +460,8 @@ struct AddressSanitizer : public FunctionPass {
   void initializeCallbacks(Module &M);
 
   bool LooksLikeCodeInBug11395(Instruction *I);
+  void removeDominatedAccesses(SmallVectorImpl<Instruction *> &ToInstrument,
+                               const TargetLibraryInfo &TLI);
   bool GlobalIsLinkerInitialized(GlobalVariable *G);
   bool isSafeAccess(ObjectSizeOffsetVisitor &ObjSizeVis, Value *Addr,
                     uint64_t TypeSize) const;
@@ -1535,12 +1551,15 @@ bool AddressSanitizer::runOnFunction(Function &F) {
     }
   }
 
+  const TargetLibraryInfo *TLI =
+      &getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
+
+  if (ClOpt && ClOptDominated) removeDominatedAccesses(ToInstrument, *TLI);
+
   bool UseCalls =
       CompileKernel ||
       (ClInstrumentationWithCallsThreshold >= 0 &&
        ToInstrument.size() > (unsigned)ClInstrumentationWithCallsThreshold);
-  const TargetLibraryInfo *TLI =
-      &getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
   const DataLayout &DL = F.getParent()->getDataLayout();
   ObjectSizeOffsetVisitor ObjSizeVis(DL, TLI, F.getContext(),
                                      /*RoundToAlign=*/true);
@@ -1593,6 +1612,162 @@ bool AddressSanitizer::LooksLikeCodeInBug11395(Instruction *I) {
   return true;
 }
 
+// Returns true if I may free or poison memory, such that an address that was
+// checked before I executed is no longer valid afterwards.
+static bool mayInvalidateChecks(Instruction *I, const TargetLibraryInfo &TLI) {
+  CallSite CS(I);
+  if (!CS) return false;
+  // Memory intrinsics only access memory, and are checked themselves.
+  if (isa<MemIntrinsic>(I)) return false;
+  if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(I)) {
+    // Lifetime markers (with -asan-check-lifetime) and stack restores change
+    // the poisoning of stack variables.
+    switch (II->getIntrinsicID()) {
+      case Intrinsic::lifetime_start:
+      case Intrinsic::lifetime_end:
+      case Intrinsic::stackrestore:
+        return true;
+      default:
+        return false;
+    }
+  }
+  // Freeing memory requires writing to it.
+  if (CS.onlyReadsMemory()) return false;
+
+  Function *Callee = CS.getCalledFunction();
+  LibFunc::Func Func;
+  if (!Callee || !TLI.getLibFunc(Callee->getName(), Func) || !TLI.has(Func))
+    return true;
+  // Library functions that write memory, but never free any.
+  switch (Func) {
+    case LibFunc::memcmp:
+    case LibFunc::memchr:
+    case LibFunc::memcpy:
+    case LibFunc::memmove:
+    case LibFunc::memset:
+    case LibFunc::strcmp:
+    case LibFunc::strncmp:
+    case LibFunc::strchr:
+    case LibFunc::strrchr:
+    case LibFunc::strlen:
+    case LibFunc::strcpy:
+    case LibFunc::strncpy:
+    case LibFunc::strcat:
+    case LibFunc::strncat:
+    case LibFunc::printf:
+    case LibFunc::fprintf:
+    case LibFunc::sprintf:
+    case LibFunc::snprintf:
+    case LibFunc::puts:
+    case LibFunc::putchar:
+    case LibFunc::fputc:
+    case LibFunc::fputs:
+    case LibFunc::fwrite:
+      return false;
+    default:
+      return true;
+  }
+}
+
+// Returns true if memory may be freed or poisoned on a path from From to To
+// that does not execute From again. From must dominate To. InvalidatingBlocks
+// holds the blocks that contain an instruction that may invalidate checks.
+static bool mayInvalidateChecksBetween(
+    Instruction *From, Instruction *To, const DominatorTree &DT,
+    const SmallPtrSetImpl<BasicBlock *> &InvalidatingBlocks,
+    const TargetLibraryInfo &TLI) {
+  if (InvalidatingBlocks.empty()) return false;
+
+  BasicBlock *FromBB = From->getParent();
+  BasicBlock *ToBB = To->getParent();
+  if (FromBB == ToBB) {
+    if (!InvalidatingBlocks.count(FromBB)) return false;
+    for (BasicBlock::iterator I = From; &*I != To; ++I)
+      if (mayInvalidateChecks(I, TLI)) return true;
+    return false;
+  }
+
+  if (InvalidatingBlocks.count(FromBB))
+    for (BasicBlock::iterator I = From, E = FromBB->end(); I != E; ++I)
+      if (mayInvalidateChecks(I, TLI)) return true;
+  if (InvalidatingBlocks.count(ToBB))
+    for (BasicBlock::iterator I = ToBB->begin(); &*I != To; ++I)
+      if (mayInvalidateChecks(I, TLI)) return true;
+
+  // Since FromBB dominates ToBB, the reachable blocks that reach ToBB without
+  // passing through FromBB are exactly the blocks between the two. ToBB is
+  // among them if it is part of such a cycle.
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  SmallVector<BasicBlock *, 16> Worklist(pred_begin(ToBB), pred_end(ToBB));
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (BB == FromBB || !DT.isReachableFromEntry(BB) ||
+        !Visited.insert(BB).second)
+      continue;
+    if (InvalidatingBlocks.count(BB)) return true;
+    Worklist.append(pred_begin(BB), pred_end(BB));
+  }
+  return false;
+}
+
+// The check of an access is redundant if a dominating access to the same
+// address, of the same or a larger size, is checked, and memory cannot be
+// freed or poisoned in between. This extends -asan-opt-same-temp across
+// basic blocks and across calls that do not free memory.
+void AddressSanitizer::removeDominatedAccesses(
+    SmallVectorImpl<Instruction *> &ToInstrument,
+    const TargetLibraryInfo &TLI) {
+  if (ToInstrument.empty()) return;
+
+  // Find the blocks that may invalidate checks once, rather than for each
+  // pair of accesses.
+  SmallPtrSet<BasicBlock *, 16> InvalidatingBlocks;
+  for (BasicBlock &BB : *ToInstrument.front()->getParent()->getParent())
+    for (Instruction &I : BB)
+      if (mayInvalidateChecks(&I, TLI)) {
+        InvalidatingBlocks.insert(&BB);
+        break;
+      }
+
+  // The accesses that stay instrumented, and their sizes, by address.
+  DenseMap<Value *, SmallVector<std::pair<Instruction *, uint64_t>, 4>>
+      Checked;
+  SmallVector<Instruction *, 16> Result;
+  bool IsWrite;
+  unsigned Alignment;
+  uint64_t TypeSize;
+  for (Instruction *I : ToInstrument) {
+    Value *Addr = isInterestingMemoryAccess(I, &IsWrite, &TypeSize, &Alignment);
+    if (!Addr) {
+      Result.push_back(I);
+      continue;
+    }
+    auto &Dominating = Checked[Addr->stripPointerCasts()];
+    bool Redundant = false;
+    // Each candidate costs a walk over the blocks in between; only the most
+    // recent ones are tried, since they are the most likely to dominate I.
+    size_t NumCandidates = std::min<size_t>(Dominating.size(),
+                                            ClOptDominatedMaxCandidates);
+    for (size_t C = Dominating.size() - NumCandidates;
+         C < Dominating.size(); ++C) {
+      auto &D = Dominating[C];
+      if (D.second >= TypeSize && DT->dominates(D.first, I) &&
+          !mayInvalidateChecksBetween(D.first, I, *DT, InvalidatingBlocks,
+                                      TLI)) {
+        Redundant = true;
+        break;
+      }
+    }
+    if (Redundant) {
+      NumOptimizedDominatedAccesses++;
+      continue;
+    }
+    Dominating.push_back(std::make_pair(I, TypeSize));
+    Result.push_back(I);
+  }
+  ToInstrument.swap(Result);
+}
+
 void FunctionStackPoisoner::initializeCallbacks(Module &M) {
   IRBuilder<> IRB(*C);
   for (int i = 0; i <= kMaxAsanStackMallocSizeClass; i++) {
@@ -10,9 +10,15 @@
 // This file implements a pass that instruments the code to perform run-time
 // bounds checking on loads, stores, and other memory intrinsics.
 //
+// Unless -bounds-checking-single-trap is given, every check branches to its
+// own trap block. The traps carry !nosanitize metadata, so that tools such as
+// ASAP can tell them apart from other calls to llvm.trap and treat every
+// check individually.
+//
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Instrumentation.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/TargetFolder.h"
@@ -61,6 +67,9 @@ namespace {
 
     BasicBlock *getTrapBB();
     void emitBranchToTrap(Value *Cmp = nullptr);
+    bool isKnownInBounds(Value *Ptr, int64_t Offset, uint64_t NeededSize,
+                         const DataLayout &DL,
+                         SmallPtrSetImpl<Value *> &Visited, unsigned Depth);
     bool instrument(Value *Ptr, Value *Val, const DataLayout &DL);
  };
 }
@@ -86,6 +95,8 @@ BasicBlock *BoundsChecking::getTrapBB() {
   TrapCall->setDoesNotReturn();
   TrapCall->setDoesNotThrow();
   TrapCall->setDebugLoc(Inst->getDebugLoc());
+  TrapCall->setMetadata(Fn->getParent()->getMDKindID("nosanitize"),
+                        MDNode::get(Fn->getContext(), None));
   Builder->CreateUnreachable();
 
   return TrapBB;
@@ -111,10 +122,65 @@ void BoundsChecking::emitBranchToTrap(Value *Cmp) {
   BasicBlock *Cont = OldBB->splitBasicBlock(Inst);
   OldBB->getTerminator()->eraseFromParent();
 
+  BranchInst *BI;
   if (Cmp)
-    BranchInst::Create(getTrapBB(), Cont, Cmp, OldBB);
+    BI = BranchInst::Create(getTrapBB(), Cont, Cmp, OldBB);
   else
-    BranchInst::Create(getTrapBB(), OldBB);
+    BI = BranchInst::Create(getTrapBB(), OldBB);
+  BI->setDebugLoc(Inst->getDebugLoc());
+}
+
+
+/// isKnownInBounds - return true if accessing NeededSize bytes at Offset bytes
+/// past Ptr stays within the underlying object, whichever object Ptr points
+/// to at run time. Unlike ObjectSizeOffsetEvaluator, this handles selects and
+/// PHIs of objects that differ in size or offset, as long as the access is in
+/// bounds for each of them.
+bool BoundsChecking::isKnownInBounds(Value *Ptr, int64_t Offset,
+                                     uint64_t NeededSize, const DataLayout &DL,
+                                     SmallPtrSetImpl<Value *> &Visited,
+                                     unsigned Depth) {
+  Ptr = Ptr->stripPointerCasts();
+  if (Depth > 8)
+    return false;
+
+  if (GEPOperator *GEP = dyn_cast<GEPOperator>(Ptr)) {
+    APInt GEPOffset(DL.getPointerTypeSizeInBits(GEP->getType()), 0);
+    if (!GEP->accumulateConstantOffset(DL, GEPOffset) ||
+        GEPOffset.getMinSignedBits() > 32)
+      return false;
+    return isKnownInBounds(GEP->getPointerOperand(),
+                           Offset + GEPOffset.getSExtValue(), NeededSize, DL,
+                           Visited, Depth + 1);
+  }
+  if (SelectInst *SI = dyn_cast<SelectInst>(Ptr))
+    return isKnownInBounds(SI->getTrueValue(), Offset, NeededSize, DL, Visited,
+                           Depth + 1) &&
+           isKnownInBounds(SI->getFalseValue(), Offset, NeededSize, DL,
+                           Visited, Depth + 1);
+  if (PHINode *PN = dyn_cast<PHINode>(Ptr)) {
+    // A cycle of PHIs may advance the pointer on each iteration.
+    if (!Visited.insert(PN).second)
+      return false;
+    for (Value *Incoming : PN->incoming_values())
+      if (!isKnownInBounds(Incoming, Offset, NeededSize, DL, Visited,
+                           Depth + 1))
+        return false;
+    return true;
+  }
+
+  ObjectSizeOffsetVisitor Visitor(DL, TLI, Ptr->getContext(),
+                                  /*RoundToAlign=*/true);
+  SizeOffsetType SizeOffset = Visitor.compute(Ptr);
+  if (!Visitor.bothKnown(SizeOffset) ||
+      SizeOffset.first.getActiveBits() > 62 ||
+      SizeOffset.second.getMinSignedBits() > 62)
+    return false;
+
+  int64_t Size = SizeOffset.first.getZExtValue();
+  int64_t Begin = SizeOffset.second.getSExtValue() + Offset;
+  return Begin >= 0 && Begin <= Size &&
+         (uint64_t)(Size - Begin) >= NeededSize;
 }
 
 
@@ -129,6 +195,12 @@ bool BoundsChecking::instrument(Value *Ptr, Value *InstVal,
   DEBUG(dbgs() << "Instrument " << *Ptr << " for " << Twine(NeededSize)
               << " bytes\n");
 
+  SmallPtrSet<Value *, 8> Visited;
+  if (isKnownInBounds(Ptr, 0, NeededSize, DL, Visited, 0)) {
+    ++ChecksSkipped;
+    return false;
+  }
+
   SizeOffsetEvalType SizeOffset = ObjSizeEval->compute(Ptr);
 
   if (!ObjSizeEval->bothKnown(SizeOffset)) {
@@ -1,17 +1,17 @@
 // This file is part of ASAP.
 // Please see LICENSE.txt for copyright and licensing information.
 
+#include "AsapReport.h"
+#include "AttackGraph.h"
 #include "SanityCheckCostPass.h"
 #include "SanityCheckInstructionsPass.h"
 #include "utils.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Pass.h"
-#include <neo4j-client.h>
 #include "llvm/IR/Module.h"
 
-namespace sanitychecks {
-class GCOVFile;
-}
-
 namespace llvm {
 class Instruction;
 }
@@ -22,7 +22,7 @@ struct SanityCheckInstructionsPass;
 struct AsapPass : public llvm::ModulePass {
   static char ID;
 
-  AsapPass() : ModulePass(ID), SCC(0), SCI(0) {}
+  AsapPass() : ModulePass(ID), SCC(0), SCI(0), UseAttackGraph(false) {}
 
   virtual bool runOnModule(llvm::Module &M);
 
@@ -33,12 +33,54 @@ private:
   SanityCheckInstructionsPass *SCI;
   std::string programName;
 
+  // Attack graph facts for this module, loaded once in runOnModule.
+  sanitychecks::AttackGraphIndex AttackGraph;
+  bool UseAttackGraph;
+
+  // Loads the attack graph from a file or the database, if any is available.
+  void loadAttackGraph();
+
   // Tries to remove a sanity check; returns true if it worked.
   bool optimizeCheckAway(llvm::Instruction *Inst);
 
+  // Removes checks by decreasing cost, up to the configured level. Sets the
+  // total cost of all checks and the cost and number of removed checks.
+  void removeChecksInCostOrder(uint64_t &TotalCost, uint64_t &RemovedCost,
+                               size_t &NChecksRemoved);
+
+  // Returns the cost that the remaining checks may have according to
+  // -asap-overhead-budget.
+  uint64_t getBudgetCost() const;
+
+  // Same as removeChecksInCostOrder, but picks checks by their marginal
+  // saving given the checks already removed (-asap-greedy).
+  void removeChecksGreedily(uint64_t &TotalCost, uint64_t &RemovedCost,
+                            size_t &NChecksRemoved);
+
+  // Removed checks that -asap-hoist-checks will try to move out of loops,
+  // grouped by function.
+  llvm::MapVector<llvm::Function *, llvm::SmallVector<llvm::BranchInst *, 8>>
+      HoistCandidates;
+
   // Method to add other checks to handle hot check removed
   bool handleHotCheckRemoved(llvm::Instruction *Inst);
 
+  // Adds range checks in loop preheaders for the candidates collected by
+  // handleHotCheckRemoved. Returns the number of hoisted checks.
+  size_t hoistRemovedChecks();
+
+  // Returns the functions with the highest total check cost, as many as
+  // requested by -asap-multiversion.
+  std::vector<llvm::Function *> selectFunctionsToMultiversion();
+
+  // Checks that were not kept as they are, for -asap-report.
+  llvm::DenseMap<llvm::BranchInst *, sanitychecks::CheckDecision> Decisions;
+
+  // Writes the report requested by -asap-report, if any. Must be called
+  // while the checks of multiversioned functions still exist.
+  void writeReport(llvm::Module &M, uint64_t TotalCost, uint64_t RemovedCost,
+                   size_t NChecksRemoved);
+
   // Method to check if the object is a safe stack object
   bool isSafeStackObject(llvm::BranchInst *branchInst);
 
@@ -0,0 +1,63 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "AsapReport.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace sanitychecks;
+
+LLVM_YAML_IS_FLOW_SEQUENCE_VECTOR(std::string)
+LLVM_YAML_IS_SEQUENCE_VECTOR(CheckReport)
+
+namespace llvm {
+namespace yaml {
+
+template <> struct ScalarEnumerationTraits<CheckDecision> {
+    static void enumeration(IO &io, CheckDecision &Value) {
+        io.enumCase(Value, "kept", CheckDecision::Kept);
+        io.enumCase(Value, "removed", CheckDecision::Removed);
+        io.enumCase(Value, "hoisted", CheckDecision::Hoisted);
+        io.enumCase(Value, "sampled", CheckDecision::Sampled);
+    }
+};
+
+template <> struct MappingTraits<CheckReport> {
+    static void mapping(IO &io, CheckReport &Check) {
+        io.mapRequired("id", Check.ID);
+        io.mapRequired("kind", Check.Kind);
+        io.mapRequired("function", Check.Function);
+        io.mapRequired("location", Check.Location);
+        io.mapOptional("inlined-at", Check.InlinedAt);
+        io.mapRequired("cost", Check.Cost);
+        io.mapRequired("decision", Check.Decision);
+    }
+};
+
+template <> struct MappingTraits<ModuleReport> {
+    static void mapping(IO &io, ModuleReport &Report) {
+        io.mapRequired("module", Report.Module);
+        io.mapRequired("total-checks", Report.TotalChecks);
+        io.mapRequired("removed-checks", Report.RemovedChecks);
+        io.mapRequired("total-cost", Report.TotalCost);
+        io.mapRequired("removed-cost", Report.RemovedCost);
+        io.mapRequired("checks", Report.Checks);
+    }
+};
+
+}  // namespace yaml
+}  // namespace llvm
+
+std::error_code sanitychecks::writeReport(StringRef Path, ModuleReport &Report) {
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::F_Text);
+    if (EC) {
+        return EC;
+    }
+    yaml::Output Out(OS);
+    Out << Report;
+    return std::error_code();
+}
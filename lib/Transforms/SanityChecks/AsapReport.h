@@ -0,0 +1,67 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+// Machine-readable report of the decisions taken by the ASAP pass
+// (-asap-report). The report of a module is a YAML document of the form:
+//
+//   module:          foo.c
+//   total-checks:    3
+//   removed-checks:  1
+//   total-cost:      1200
+//   removed-cost:    1000
+//   checks:
+//     - id:          9815093452130174235
+//       kind:        asan
+//       function:    foo
+//       location:    foo.c:12:7
+//       inlined-at:  [ 'bar.c:3:5' ]
+//       cost:        1000
+//       decision:    removed
+//
+// Reports of several modules can be concatenated into a YAML stream.
+
+#ifndef SANITYCHECKS_ASAPREPORT_H
+#define SANITYCHECKS_ASAPREPORT_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace sanitychecks {
+
+/// What ASAP did with a sanity check.
+enum class CheckDecision {
+    Kept,
+    Removed,
+    Hoisted,  // Removed, but replaced by a range check before its loop
+    Sampled   // Only kept in the checked variant of a multiversioned function
+};
+
+struct CheckReport {
+    uint64_t ID;
+    std::string Kind;
+    std::string Function;
+    std::string Location;
+    std::vector<std::string> InlinedAt;
+    uint64_t Cost;
+    CheckDecision Decision;
+};
+
+struct ModuleReport {
+    std::string Module;
+    uint64_t TotalChecks;
+    uint64_t RemovedChecks;
+    uint64_t TotalCost;
+    uint64_t RemovedCost;
+    std::vector<CheckReport> Checks;
+};
+
+/// Writes Report to Path as a YAML document.
+std::error_code writeReport(llvm::StringRef Path, ModuleReport &Report);
+
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_ASAPREPORT_H */
@@ -0,0 +1,151 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "AttackGraph.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef ASAP_HAVE_NEO4J
+#include <cerrno>
+#include <neo4j-client.h>
+#endif
+
+#include <system_error>
+#define DEBUG_TYPE "asap-attack-graph"
+
+using namespace llvm;
+using namespace sanitychecks;
+
+bool AttackGraphIndex::loadFromFile(StringRef Path, StringRef ProgramName,
+                                    std::string &Error) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buff = MemoryBuffer::getFile(Path);
+    if (std::error_code EC = Buff.getError()) {
+        Error = (Path + ": " + EC.message()).str();
+        return false;
+    }
+
+    for (line_iterator LI(*Buff.get(), /*SkipBlanks=*/true, '#'); !LI.is_at_eof(); ++LI) {
+        std::pair<StringRef, StringRef> Program = LI->split('\t');
+        std::pair<StringRef, StringRef> Function = Program.second.split('\t');
+        if (Function.second.empty()) {
+            Error = (Path + ":" + Twine(LI.line_number()) +
+                     ": expected program, function and instruction").str();
+            return false;
+        }
+        if (Program.first == ProgramName) {
+            insert(Function.first, Function.second);
+        }
+    }
+
+    DEBUG(dbgs() << "Loaded " << NumEntries << " attack graph facts from "
+                 << Path << "\n");
+    return true;
+}
+
+#ifdef ASAP_HAVE_NEO4J
+namespace {
+    StringRef getStringValue(neo4j_value_t Value) {
+        if (neo4j_type(Value) != NEO4J_STRING) return StringRef();
+        return StringRef(neo4j_ustring_value(Value), neo4j_string_length(Value));
+    }
+}  // anonymous namespace
+
+bool AttackGraphIndex::loadFromDatabase(StringRef URI, StringRef ProgramName,
+                                        std::string &Error) {
+    std::string URIStr = URI;
+    std::string ProgramNameStr = ProgramName;
+    char ErrorBuf[256];
+
+    neo4j_map_entry_t MapEntries[2] = {
+        neo4j_map_entry("program_name", neo4j_string(ProgramNameStr.c_str())),
+        neo4j_map_entry("action_type", neo4j_string("AttackAction"))
+    };
+
+    // Fetch everything the attack graph knows about this program at once,
+    // rather than asking for each instruction separately.
+    const char *Statement =
+        " MATCH (a:AttackGraphNode)-[:EDGE]->(p:ProgramInstruction) "
+        "WHERE a.program_name=p.program_name=$program_name AND "
+        "a.type=$action_type RETURN p.function_name, p.instruction";
+
+    neo4j_connection_t *Connection =
+        neo4j_connect(URIStr.c_str(), NULL, NEO4J_INSECURE);
+    if (!Connection) {
+        Error = URIStr + ": " + neo4j_strerror(errno, ErrorBuf, sizeof(ErrorBuf));
+        return false;
+    }
+
+    bool Success = true;
+    neo4j_result_stream_t *Results =
+        neo4j_run(Connection, Statement, neo4j_map(MapEntries, 2));
+    if (!Results) {
+        Error = URIStr + ": " + neo4j_strerror(errno, ErrorBuf, sizeof(ErrorBuf));
+        Success = false;
+    } else {
+        neo4j_result_t *Record;
+        while ((Record = neo4j_fetch_next(Results)) != NULL) {
+            insert(getStringValue(neo4j_result_field(Record, 0)),
+                   getStringValue(neo4j_result_field(Record, 1)));
+        }
+        if (int EC = neo4j_check_failure(Results)) {
+            Error = URIStr + ": " + neo4j_strerror(EC, ErrorBuf, sizeof(ErrorBuf));
+            Success = false;
+        }
+        neo4j_close_results(Results);
+    }
+    neo4j_close(Connection);
+
+    DEBUG(dbgs() << "Loaded " << NumEntries << " attack graph facts from "
+                 << URI << "\n");
+    return Success;
+}
+#else
+bool AttackGraphIndex::loadFromDatabase(StringRef URI, StringRef ProgramName,
+                                        std::string &Error) {
+    Error = "ASAP was built without neo4j support; cannot query " + URI.str();
+    return false;
+}
+#endif
+
+void AttackGraphIndex::insert(StringRef FunctionName, StringRef Instruction) {
+    StringRef Fingerprint = getFingerprint(Instruction);
+    if (Fingerprint.empty()) return;
+    if (UnsafeInstructions[FunctionName].insert(Fingerprint).second) {
+        NumEntries += 1;
+    }
+}
+
+bool AttackGraphIndex::isUnsafe(const Instruction *Inst) const {
+    SmallString<128> InstructionString;
+    raw_svector_ostream OS(InstructionString);
+    OS << *Inst;
+    return isUnsafe(getFunctionName(Inst), OS.str());
+}
+
+bool AttackGraphIndex::isUnsafe(StringRef FunctionName,
+                                StringRef Instruction) const {
+    auto FI = UnsafeInstructions.find(FunctionName);
+    if (FI == UnsafeInstructions.end()) return false;
+    return FI->second.count(getFingerprint(Instruction));
+}
+
+StringRef AttackGraphIndex::getFingerprint(StringRef Instruction) {
+    // Metadata attachments (", !dbg !42") are printed last, and their
+    // numbering depends on the rest of the module.
+    Instruction = Instruction.substr(0, Instruction.find(", !"));
+    return Instruction.trim();
+}
+
+StringRef AttackGraphIndex::getFunctionName(const Instruction *Inst) {
+    const BasicBlock *BB = Inst->getParent();
+    if (BB && BB->getParent()) return BB->getParent()->getName();
+    return "NULL";
+}
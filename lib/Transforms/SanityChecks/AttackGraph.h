@@ -0,0 +1,66 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#ifndef SANITYCHECKS_ATTACKGRAPH_H
+#define SANITYCHECKS_ATTACKGRAPH_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+
+#include <string>
+
+namespace llvm {
+    class Instruction;
+}
+
+namespace sanitychecks {
+
+/// AttackGraphIndex - An in-memory index of the program instructions that the
+/// attack graph reaches through an attack action. The facts for a program are
+/// loaded once, either from a local export or with a single query against the
+/// attack graph database, and are keyed by function name and a canonical
+/// fingerprint of the instruction, so that testing an instruction is a hash
+/// lookup.
+class AttackGraphIndex {
+public:
+    AttackGraphIndex() : NumEntries(0) {}
+
+    /// Loads all facts of the given program from a tab-separated export. Each
+    /// line has the form "program_name<TAB>function_name<TAB>instruction";
+    /// empty lines and lines starting with '#' are ignored. Returns false and
+    /// sets Error if the file cannot be read or is malformed.
+    bool loadFromFile(llvm::StringRef Path, llvm::StringRef ProgramName,
+                      std::string &Error);
+
+    /// Loads all facts of the given program from the neo4j database at URI,
+    /// using a single query. Returns false and sets Error on failure, or if
+    /// ASAP was built without neo4j support.
+    bool loadFromDatabase(llvm::StringRef URI, llvm::StringRef ProgramName,
+                          std::string &Error);
+
+    /// Records that the given instruction of FunctionName is an attack target.
+    void insert(llvm::StringRef FunctionName, llvm::StringRef Instruction);
+
+    /// Returns true if the attack graph reaches the given instruction.
+    bool isUnsafe(const llvm::Instruction *Inst) const;
+    bool isUnsafe(llvm::StringRef FunctionName,
+                  llvm::StringRef Instruction) const;
+
+    size_t size() const { return NumEntries; }
+
+    /// Returns the textual instruction, with surrounding whitespace and
+    /// metadata attachments (whose numbering is not stable) removed.
+    static llvm::StringRef getFingerprint(llvm::StringRef Instruction);
+
+    /// Returns the name under which facts about Inst are stored.
+    static llvm::StringRef getFunctionName(const llvm::Instruction *Inst);
+
+private:
+    llvm::StringMap<llvm::StringSet<> > UnsafeInstructions;
+    size_t NumEntries;
+};
+
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_ATTACKGRAPH_H */
@@ -0,0 +1,314 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "BlockProfile.h"
+#include "GCOVCounts.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/ProfileData/SampleProfReader.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <system_error>
+#define DEBUG_TYPE "asap-block-profile"
+
+using namespace llvm;
+using namespace llvm::sampleprof;
+using namespace sanitychecks;
+
+namespace {
+
+// Counts from GCOV data. Blocks are matched by position, which requires the IR
+// to have the same shape as when the coverage notes were created.
+class GCOVBlockProfile : public BlockProfile {
+public:
+    GCOVBlockProfile(std::unique_ptr<GCOVCounts> GC) : GC(std::move(GC)) {}
+
+    void prepare(Function &F, Pass &P) override {
+        GCOVCounts::FunctionBlocks Blocks = GC->getFunctionBlocks(F.getName());
+        if (Blocks.Counts.empty()) {
+            // FIXME: Sometimes GCOV data seems to be missing some functions.
+            // I haven't yet found out why this is so. I currently silently
+            // ignore the issue, but this might cause problems.
+            DEBUG(dbgs() << "Warning: could not find function " << F.getName()
+                         << " in GCOV data\n");
+            return;
+        }
+
+        // GCOVProfiler::emitProfileNotes() splits the entry block of the
+        // function. It also adds a "return block", which is always the last
+        // block. Hence the first and last GCOV blocks are unused, and hence
+        // the +2.
+        // The blocks of F are mapped once, here, so that getCount is a single
+        // hash lookup for every instruction of F.
+        assert(F.size() + 2 == Blocks.Counts.size()
+                && "Function size does not match GCOV data?");
+        unsigned I = 1;  // Skip split entry block
+        for (const BasicBlock &BB : F) {
+            assert(((isa<ReturnInst>(BB.getTerminator()) && Blocks.NumDstArcs[I] == 1) ||
+                    (BB.getTerminator()->getNumSuccessors() == Blocks.NumDstArcs[I]))
+                    && "CFG mismatch: dst edges");
+            Counts[&BB] = Blocks.Counts[I];
+            ++I;
+        }
+    }
+
+    uint64_t getCount(const BasicBlock *BB) const override {
+        return Counts.lookup(BB);
+    }
+
+private:
+    std::unique_ptr<GCOVCounts> GC;
+    DenseMap<const BasicBlock*, uint64_t> Counts;
+};
+
+// Counts from an indexed instrumentation profile, as produced by
+// `llvm-profdata merge` from a -fprofile-instr-generate build.
+//
+// Clang's counters belong to AST regions, and can only be mapped to blocks by
+// the frontend. We use the function entry counter (the first counter of each
+// record), and distribute it over blocks according to BlockFrequencyInfo. If
+// the module was compiled with -fprofile-instr-use, the block frequencies are
+// based on the same profile.
+class InstrBlockProfile : public BlockProfile {
+public:
+    InstrBlockProfile(InstrProfReader &Reader) {
+        for (const InstrProfRecord &Record: Reader) {
+            if (Record.Counts.empty()) continue;
+            // The profile is keyed by the frontend's function hash, which we
+            // cannot compute from IR. If a name occurs with several hashes,
+            // take the largest count.
+            uint64_t &Count = EntryCounts[Record.Name];
+            Count = std::max(Count, Record.Counts[0]);
+        }
+    }
+
+    void prepare(Function &F, Pass &P) override {
+        uint64_t EntryCount = EntryCounts.lookup(getPGOFuncName(F));
+        DEBUG(dbgs() << "Entry count of " << F.getName() << ": " << EntryCount
+                     << "\n");
+        if (EntryCount == 0) return;
+
+        BlockFrequencyInfo &BFI = P.getAnalysis<BlockFrequencyInfo>(F);
+        double Scale = (double)EntryCount / BFI.getEntryFreq();
+        for (BasicBlock &BB: F) {
+            Counts[&BB] = (uint64_t)(BFI.getBlockFreq(&BB).getFrequency() * Scale + 0.5);
+        }
+    }
+
+    uint64_t getCount(const BasicBlock *BB) const override {
+        return Counts.lookup(BB);
+    }
+
+private:
+    StringMap<uint64_t> EntryCounts;
+    DenseMap<const BasicBlock*, uint64_t> Counts;
+
+    // Returns the name under which clang stores F's counters. Functions with
+    // local linkage are prefixed with the name of their main source file.
+    static std::string getPGOFuncName(const Function &F) {
+        if (!F.hasLocalLinkage()) return F.getName();
+        StringRef FileName = sys::path::filename(F.getParent()->getModuleIdentifier());
+        if (FileName.empty()) FileName = "<unknown>";
+        return (FileName + ":" + F.getName()).str();
+    }
+};
+
+// Counts from a sample profile. Samples are attributed to source lines; a
+// block's count is the largest number of samples of any of its instructions,
+// like in the SampleProfile pass. Counts are proportional to, but usually
+// much smaller than, the actual number of executions.
+class SampleBlockProfile : public BlockProfile {
+public:
+    SampleBlockProfile(std::unique_ptr<SampleProfileReader> Reader)
+        : Reader(std::move(Reader)) {}
+
+    void prepare(Function &F, Pass &P) override {
+        DISubprogram *S = getDISubprogram(&F);
+        if (!S) {
+            DEBUG(dbgs() << "No debug information for " << F.getName() << "\n");
+            return;
+        }
+        unsigned HeaderLineno = S->getLine();
+
+        FunctionSamples *Samples = Reader->getSamplesFor(F);
+        if (Samples->empty()) return;
+
+        for (BasicBlock &BB: F) {
+            unsigned Count = 0;
+            for (Instruction &I: BB) {
+                const DILocation *DIL = I.getDebugLoc();
+                if (!DIL || DIL->getLine() < HeaderLineno) continue;
+                Count = std::max(Count, Samples->samplesAt(
+                    DIL->getLine() - HeaderLineno, DIL->getDiscriminator()));
+            }
+            if (Count) Counts[&BB] = Count;
+        }
+    }
+
+    uint64_t getCount(const BasicBlock *BB) const override {
+        return Counts.lookup(BB);
+    }
+
+private:
+    std::unique_ptr<SampleProfileReader> Reader;
+    DenseMap<const BasicBlock*, uint64_t> Counts;
+};
+
+// Counts from an ASAP line profile, i.e., the number of samples per source
+// line, e.g., converted from `perf script -F ip,srcline` output by asap-clang.
+// Unlike a sample profile, lines are not relative to their function, so the
+// profile can be created from any binary with line tables, without knowing
+// its functions. Lines are identified by the file's base name, since the
+// binary and the IR may refer to the same file through different paths.
+class LineBlockProfile : public BlockProfile {
+public:
+    static const char Header[];
+
+    bool read(const MemoryBuffer &Buffer, StringRef Path, std::string &Error) {
+        for (line_iterator I(Buffer, /*SkipBlanks=*/true, '#'); !I.is_at_eof(); ++I) {
+            StringRef Line = I->trim();
+
+            // <count> <file>:<line>
+            std::pair<StringRef, StringRef> CountAndLoc = Line.split(' ');
+            std::pair<StringRef, StringRef> FileAndLine =
+                CountAndLoc.second.trim().rsplit(':');
+            uint64_t Count;
+            unsigned SourceLine;
+            if (CountAndLoc.first.getAsInteger(10, Count) ||
+                FileAndLine.second.getAsInteger(10, SourceLine) ||
+                FileAndLine.first.empty()) {
+                Error = (Path + ":" + Twine(I.line_number()) +
+                         ": invalid line profile entry").str();
+                return false;
+            }
+            SamplesByLine[getKey(FileAndLine.first, SourceLine)] += Count;
+        }
+        return true;
+    }
+
+    void prepare(Function &F, Pass &P) override {
+        for (BasicBlock &BB: F) {
+            uint64_t Count = 0;
+            for (Instruction &I: BB) {
+                const DILocation *DIL = I.getDebugLoc();
+                if (!DIL) continue;
+                Count = std::max(Count, SamplesByLine.lookup(
+                    getKey(DIL->getFilename(), DIL->getLine())));
+            }
+            if (Count) Counts[&BB] = Count;
+        }
+    }
+
+    uint64_t getCount(const BasicBlock *BB) const override {
+        return Counts.lookup(BB);
+    }
+
+private:
+    StringMap<uint64_t> SamplesByLine;
+    DenseMap<const BasicBlock*, uint64_t> Counts;
+
+    static std::string getKey(StringRef File, unsigned Line) {
+        return (sys::path::filename(File) + ":" + Twine(Line)).str();
+    }
+};
+
+const char LineBlockProfile::Header[] = "# asap-line-profile";
+
+ErrorOr<std::unique_ptr<MemoryBuffer>> readGCOVFile(StringRef Path,
+                                                    std::string &Error) {
+    // Large files are mapped rather than copied; GCOVCounts refers to the
+    // function names in the notes file.
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buff =
+        MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+    if (std::error_code EC = Buff.getError()) {
+        Error = (Path + ":" + EC.message()).str();
+    }
+    return Buff;
+}
+
+}  // anonymous namespace
+
+std::unique_ptr<BlockProfile>
+BlockProfile::createFromGCOV(StringRef GCNOPath,
+                             ArrayRef<WeightedFile> GCDAFiles,
+                             std::string &Error) {
+    std::unique_ptr<GCOVCounts> GC(new GCOVCounts);
+    ErrorOr<std::unique_ptr<MemoryBuffer>> GCNO = readGCOVFile(GCNOPath, Error);
+    if (!GCNO) {
+        return nullptr;
+    }
+    if (!GC->readGCNO(std::move(GCNO.get()))) {
+        Error = (GCNOPath + ": Invalid .gcno file!").str();
+        return nullptr;
+    }
+    for (const WeightedFile &GCDA: GCDAFiles) {
+        ErrorOr<std::unique_ptr<MemoryBuffer>> Buff =
+            readGCOVFile(GCDA.Path, Error);
+        if (!Buff) {
+            return nullptr;
+        }
+        if (!GC->readGCDA(*Buff.get(), GCDA.Weight)) {
+            Error = GCDA.Path + ": Invalid .gcda file!";
+            return nullptr;
+        }
+    }
+    return std::unique_ptr<BlockProfile>(new GCOVBlockProfile(std::move(GC)));
+}
+
+std::unique_ptr<BlockProfile>
+BlockProfile::createFromProfile(StringRef Path, LLVMContext &Context,
+                                std::string &Error) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buff = MemoryBuffer::getFile(Path);
+    if (std::error_code EC = Buff.getError()) {
+        Error = (Path + ": " + EC.message()).str();
+        return nullptr;
+    }
+
+    if (Buff.get()->getBuffer().startswith(LineBlockProfile::Header)) {
+        std::unique_ptr<LineBlockProfile> Profile(new LineBlockProfile);
+        if (!Profile->read(*Buff.get(), Path, Error)) {
+            return nullptr;
+        }
+        return Profile;
+    }
+
+    if (IndexedInstrProfReader::hasFormat(*Buff.get())) {
+        auto Reader = IndexedInstrProfReader::create(std::move(Buff.get()));
+        if (std::error_code EC = Reader.getError()) {
+            Error = (Path + ": " + EC.message()).str();
+            return nullptr;
+        }
+        std::unique_ptr<InstrBlockProfile> Profile(new InstrBlockProfile(*Reader.get()));
+        if (Reader.get()->hasError()) {
+            Error = (Path + ": " + Reader.get()->getError().message()).str();
+            return nullptr;
+        }
+        return Profile;
+    }
+
+    auto Reader = SampleProfileReader::create(Path, Context);
+    if (std::error_code EC = Reader.getError()) {
+        Error = (Path + ": " + EC.message()).str();
+        return nullptr;
+    }
+    if (std::error_code EC = Reader.get()->read()) {
+        Error = (Path + ": " + EC.message()).str();
+        return nullptr;
+    }
+    return std::unique_ptr<BlockProfile>(new SampleBlockProfile(std::move(Reader.get())));
+}
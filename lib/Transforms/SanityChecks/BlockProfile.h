@@ -0,0 +1,73 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+// Execution counts of basic blocks, from one of the profile formats that ASAP
+// can use to compute the costs of sanity checks:
+//
+// - GCOV data (.gcno and .gcda files) of a coverage-instrumented build,
+//   possibly merged from several weighted runs,
+// - indexed instrumentation profiles (.profdata files, as used for PGO),
+// - sample profiles, e.g., converted from `perf record` data,
+// - line profiles, i.e., samples per source line, as written by asap-clang
+//   from `perf record` data without further tools.
+
+#ifndef SANITYCHECKS_BLOCKPROFILE_H
+#define SANITYCHECKS_BLOCKPROFILE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace llvm {
+    class BasicBlock;
+    class Function;
+    class LLVMContext;
+    class Pass;
+}
+
+namespace sanitychecks {
+
+/// A profile data file whose counts are multiplied by Weight when merging it
+/// with others.
+struct WeightedFile {
+    std::string Path;
+    uint64_t Weight;
+};
+
+/// BlockProfile - Provides the execution count of each basic block.
+///
+/// prepare() must be called for a function before the counts of its blocks
+/// are requested. prepare() may run analyses through the pass manager and is
+/// not thread-safe; once all functions have been prepared, getCount() can be
+/// called from several threads.
+class BlockProfile {
+public:
+    virtual ~BlockProfile() {}
+
+    /// Computes the counts for the blocks of F. P is the pass that owns this
+    /// profile; it must require BlockFrequencyInfo.
+    virtual void prepare(llvm::Function &F, llvm::Pass &P) = 0;
+
+    /// Returns the execution count of BB, or zero if it is unknown.
+    virtual uint64_t getCount(const llvm::BasicBlock *BB) const = 0;
+
+    /// Reads GCOV data. Blocks are matched by their position in the function.
+    /// The counts of all GCDA files are added up, after multiplying them by
+    /// the file's weight. Files are read one at a time.
+    static std::unique_ptr<BlockProfile>
+    createFromGCOV(llvm::StringRef GCNOPath,
+                   llvm::ArrayRef<WeightedFile> GCDAFiles, std::string &Error);
+
+    /// Reads an indexed instrumentation profile, a sample profile or a line
+    /// profile, depending on the file's format.
+    static std::unique_ptr<BlockProfile>
+    createFromProfile(llvm::StringRef Path, llvm::LLVMContext &Context,
+                      std::string &Error);
+};
+
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_BLOCKPROFILE_H */
@@ -0,0 +1,40 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "CostCalibration.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstdlib>
+#include <system_error>
+
+using namespace llvm;
+using namespace sanitychecks;
+
+std::unique_ptr<CostCalibration>
+CostCalibration::create(StringRef Path, std::string &Error) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buff = MemoryBuffer::getFile(Path);
+    if (std::error_code EC = Buff.getError()) {
+        Error = (Path + ": " + EC.message()).str();
+        return nullptr;
+    }
+
+    std::unique_ptr<CostCalibration> Result(new CostCalibration);
+    for (line_iterator I(*Buff.get(), /*SkipBlanks=*/true, '#'), E; I != E; ++I) {
+        SmallVector<StringRef, 2> Fields;
+        I->split(Fields, " ", -1, /*KeepEmpty=*/false);
+        std::string CostString = Fields.size() == 2 ? Fields[1].str() : "";
+        char *End;
+        double Cost = strtod(CostString.c_str(), &End);
+        if (CostString.empty() || *End != '\0' || !(Cost >= 0)) {
+            Error = (Path + ":" + Twine(I.line_number()) +
+                     ": expected a function name and a cost").str();
+            return nullptr;
+        }
+        Result->Costs[Fields[0]] = Cost;
+    }
+    return Result;
+}
@@ -0,0 +1,50 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+// Measured costs of sanity checks, as written by the asap-calibrate tool. A
+// calibration table is a text file with one entry per line: the name of the
+// function that a check calls when it fails, followed by the number of cycles
+// that an execution of the (passing) check takes. Empty lines and lines
+// starting with '#' are ignored, e.g.:
+//
+//   # asap-calibrate, haswell
+//   __asan_report_load4 3.41
+//   __asan_report_load4:slow 9.12
+//   __ubsan_handle_add_overflow_abort 0.87
+//
+// The ":slow" entry of an ASan check of less than 8 bytes is the cost of the
+// check when its slow path runs every time, i.e., when the shadow byte is
+// nonzero.
+
+#ifndef SANITYCHECKS_COSTCALIBRATION_H
+#define SANITYCHECKS_COSTCALIBRATION_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+#include <string>
+
+namespace sanitychecks {
+
+/// CostCalibration - The measured cost of each kind of sanity check.
+class CostCalibration {
+public:
+    /// Reads a calibration table. Returns nullptr and sets Error on failure.
+    static std::unique_ptr<CostCalibration> create(llvm::StringRef Path,
+                                                   std::string &Error);
+
+    /// Returns the cost in cycles of a check that calls ReportFunction when it
+    /// fails, or a negative value if the table has no such entry.
+    double getCost(llvm::StringRef ReportFunction) const {
+        auto I = Costs.find(ReportFunction);
+        return I == Costs.end() ? -1.0 : I->getValue();
+    }
+
+private:
+    llvm::StringMap<double> Costs;
+};
+
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_COSTCALIBRATION_H */
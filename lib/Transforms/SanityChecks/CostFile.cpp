@@ -0,0 +1,66 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "CostFile.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace sanitychecks;
+
+namespace {
+    template <typename T>
+    void writeLE(raw_ostream &OS, T Value) {
+        char Bytes[sizeof(T)];
+        support::endian::write<T, support::little, support::unaligned>(Bytes, Value);
+        OS.write(Bytes, sizeof(T));
+    }
+}  // anonymous namespace
+
+std::error_code costfile::writeCostFile(StringRef Path,
+                                        const std::vector<Entry> &Entries,
+                                        uint64_t BaselineCost,
+                                        uint32_t Flags) {
+    // Lay out the string table first; checks often share a location.
+    StringMap<uint64_t> LocationOffsets;
+    std::vector<uint64_t> Offsets;
+    std::string StringTable;
+    uint64_t TotalCost = 0;
+    for (const Entry &E: Entries) {
+        auto LO = LocationOffsets.insert(std::make_pair(E.Location, StringTable.size()));
+        if (LO.second) {
+            StringTable += E.Location;
+            StringTable += '\0';
+        }
+        Offsets.push_back(LO.first->second);
+        TotalCost += E.Cost;
+    }
+
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+    if (EC) return EC;
+
+    OS.write(Magic, sizeof(Magic));
+    writeLE<uint32_t>(OS, Version);
+    writeLE<uint32_t>(OS, Flags);
+    writeLE<uint64_t>(OS, Entries.size());
+    writeLE<uint64_t>(OS, TotalCost);
+    writeLE<uint64_t>(OS, StringTable.size());
+    writeLE<uint64_t>(OS, BaselineCost);
+
+    for (size_t I = 0, N = Entries.size(); I != N; ++I) {
+        writeLE<uint64_t>(OS, Entries[I].Cost);
+        writeLE<uint64_t>(OS, Entries[I].CheckID);
+        writeLE<uint64_t>(OS, Offsets[I]);
+    }
+    OS << StringTable;
+
+    OS.close();
+    if (OS.has_error()) {
+        OS.clear_error();
+        return std::make_error_code(std::errc::io_error);
+    }
+    return std::error_code();
+}
@@ -0,0 +1,137 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+// Binary format for the costs of sanity checks. A cost file consists of
+//
+// - a Header, which also holds the estimated cost of the rest of the code
+//   (BaselineCost), in the same unit as the checks' costs; if the checks'
+//   costs were measured (the CalibratedCosts flag), there is no baseline,
+// - Header.NumRecords fixed-size Records, sorted by decreasing cost,
+// - a string table of Header.StringTableSize bytes, containing the
+//   NUL-terminated debug locations referred to by the records.
+//
+// All integers are little-endian and unaligned, so that readers can use the
+// file in place, e.g. through a memory mapping.
+
+#ifndef SANITYCHECKS_COSTFILE_H
+#define SANITYCHECKS_COSTFILE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace sanitychecks {
+namespace costfile {
+
+const char Magic[8] = {'A', 'S', 'A', 'P', 'C', 'S', 'T', '\0'};
+const uint32_t Version = 3;
+
+/// Header flags.
+enum : uint32_t {
+    /// Costs are in cycles, from -asap-calibration; BaselineCost is unknown.
+    CalibratedCosts = 1
+};
+
+struct Header {
+    char Magic[8];
+    llvm::support::ulittle32_t Version;
+    llvm::support::ulittle32_t Flags;
+    llvm::support::ulittle64_t NumRecords;
+    llvm::support::ulittle64_t TotalCost;
+    llvm::support::ulittle64_t StringTableSize;
+    llvm::support::ulittle64_t BaselineCost;
+};
+
+struct Record {
+    llvm::support::ulittle64_t Cost;
+    llvm::support::ulittle64_t CheckID;
+    llvm::support::ulittle64_t LocationOffset;
+};
+
+static_assert(sizeof(Header) == 48, "Header must not contain padding");
+static_assert(sizeof(Record) == 24, "Record must not contain padding");
+
+/// An entry to be written by writeCostFile.
+struct Entry {
+    uint64_t Cost;
+    uint64_t CheckID;
+    std::string Location;
+};
+
+/// Writes Entries, which must be sorted by decreasing cost, to Path.
+std::error_code writeCostFile(llvm::StringRef Path,
+                              const std::vector<Entry> &Entries,
+                              uint64_t BaselineCost, uint32_t Flags = 0);
+
+/// Provides access to the records of a cost file, without copying them.
+class Reader {
+public:
+    static llvm::ErrorOr<std::unique_ptr<Reader>> create(llvm::StringRef Path) {
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> Buff =
+            llvm::MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+        if (std::error_code EC = Buff.getError())
+            return EC;
+
+        std::unique_ptr<Reader> R(new Reader(std::move(Buff.get())));
+        if (!R->isValid())
+            return std::make_error_code(std::errc::invalid_argument);
+        return R;
+    }
+
+    const Header &getHeader() const {
+        return *reinterpret_cast<const Header *>(Buffer->getBufferStart());
+    }
+
+    llvm::ArrayRef<Record> records() const {
+        return llvm::makeArrayRef(
+            reinterpret_cast<const Record *>(Buffer->getBufferStart() +
+                                             sizeof(Header)),
+            getHeader().NumRecords);
+    }
+
+    llvm::StringRef getLocation(const Record &R) const {
+        if (R.LocationOffset >= getHeader().StringTableSize)
+            return llvm::StringRef();
+        return llvm::StringRef(getStringTable() + R.LocationOffset);
+    }
+
+private:
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+    Reader(std::unique_ptr<llvm::MemoryBuffer> Buffer)
+        : Buffer(std::move(Buffer)) {}
+
+    const char *getStringTable() const {
+        return Buffer->getBufferStart() + sizeof(Header) +
+               getHeader().NumRecords * sizeof(Record);
+    }
+
+    bool isValid() const {
+        size_t Size = Buffer->getBufferSize();
+        if (Size < sizeof(Header))
+            return false;
+        const Header &H = getHeader();
+        if (memcmp(H.Magic, Magic, sizeof(Magic)) != 0 || H.Version != Version)
+            return false;
+        if (H.NumRecords > (Size - sizeof(Header)) / sizeof(Record))
+            return false;
+        uint64_t StringsEnd =
+            sizeof(Header) + H.NumRecords * sizeof(Record) + H.StringTableSize;
+        if (StringsEnd != Size)
+            return false;
+        // Locations must be NUL-terminated within the string table.
+        return H.StringTableSize == 0 || Buffer->getBufferEnd()[-1] == '\0';
+    }
+};
+
+}  // namespace costfile
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_COSTFILE_H */
@@ -0,0 +1,201 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "GCOVCounts.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace sanitychecks;
+
+bool GCOVCounts::readGCNO(std::unique_ptr<MemoryBuffer> Buffer) {
+    GCNO = std::move(Buffer);
+    GCOVBuffer Buff(GCNO.get());
+    if (!Buff.readGCNOFormat()) return false;
+    if (!Buff.readGCOVVersion(Version)) return false;
+    if (!Buff.readInt(Checksum)) return false;
+
+    while (Buff.readFunctionTag()) {
+        FunctionRecord F;
+        if (!readFunctionGCNO(Buff, F)) return false;
+        // Prefer the first function of a given name.
+        FunctionsByName.insert(std::make_pair(F.Name, Functions.size()));
+        Functions.push_back(F);
+    }
+    return true;
+}
+
+bool GCOVCounts::readFunctionGCNO(GCOVBuffer &Buff, FunctionRecord &F) {
+    uint32_t Dummy;
+    if (!Buff.readInt(Dummy)) return false;  // Function header length
+    if (!Buff.readInt(F.Ident)) return false;
+    if (!Buff.readInt(F.Checksum)) return false;
+    if (Version != GCOV::V402) {
+        uint32_t CfgChecksum;
+        if (!Buff.readInt(CfgChecksum)) return false;
+        if (Checksum != CfgChecksum) {
+            errs() << "File checksums do not match: " << Checksum
+                   << " != " << CfgChecksum << ".\n";
+            return false;
+        }
+    }
+    StringRef Filename;
+    uint32_t LineNumber;
+    if (!Buff.readString(F.Name)) return false;
+    if (!Buff.readString(Filename)) return false;
+    if (!Buff.readInt(LineNumber)) return false;
+
+    if (!Buff.readBlockTag()) {
+        errs() << "Block tag not found.\n";
+        return false;
+    }
+    uint32_t NumBlocks;
+    if (!Buff.readInt(NumBlocks)) return false;
+    Buff.advanceCursor(NumBlocks);  // Block flags
+    F.FirstBlock = Counts.size();
+    F.NumBlocks = NumBlocks;
+    Counts.resize(Counts.size() + NumBlocks);
+    NumDstArcs.resize(NumDstArcs.size() + NumBlocks);
+
+    F.FirstArc = Arcs.size();
+    while (Buff.readEdgeTag()) {
+        uint32_t NumEdges;
+        if (!Buff.readInt(NumEdges)) return false;
+        NumEdges = (NumEdges - 1) / 2;
+        uint32_t BlockNo;
+        if (!Buff.readInt(BlockNo)) return false;
+        if (BlockNo >= NumBlocks) {
+            errs() << "Unexpected block number: " << BlockNo << " (in "
+                   << F.Name << ").\n";
+            return false;
+        }
+        for (uint32_t i = 0; i != NumEdges; ++i) {
+            uint32_t Dst;
+            if (!Buff.readInt(Dst)) return false;
+            if (Dst >= NumBlocks) {
+                errs() << "Unexpected block number: " << Dst << " (in "
+                       << F.Name << ").\n";
+                return false;
+            }
+            if (!Buff.readInt(Dummy)) return false;  // Edge flag
+            Arcs.push_back(Arc{BlockNo, Dst});
+            ++NumDstArcs[F.FirstBlock + BlockNo];
+        }
+    }
+    F.NumArcs = Arcs.size() - F.FirstArc;
+    // The data file lists counts block by block, and for each block in the
+    // order in which its arcs appear in the notes file.
+    std::stable_sort(Arcs.begin() + F.FirstArc, Arcs.end(),
+                     [](const Arc &A, const Arc &B) { return A.Src < B.Src; });
+
+    // Line tables are only needed for coverage reports.
+    while (Buff.readLineTag()) {
+        uint32_t LineTableLength;
+        if (!Buff.readInt(LineTableLength)) return false;
+        Buff.advanceCursor(LineTableLength);
+    }
+    return true;
+}
+
+bool GCOVCounts::readGCDA(MemoryBuffer &Buffer, uint64_t Weight) {
+    assert(GCNO && "readGCDA() can only be called after readGCNO()");
+    GCOVBuffer Buff(&Buffer);
+    if (!Buff.readGCDAFormat()) return false;
+    GCOV::GCOVVersion GCDAVersion;
+    if (!Buff.readGCOVVersion(GCDAVersion)) return false;
+    if (Version != GCDAVersion) {
+        errs() << "GCOV versions do not match.\n";
+        return false;
+    }
+    uint32_t GCDAChecksum;
+    if (!Buff.readInt(GCDAChecksum)) return false;
+    if (Checksum != GCDAChecksum) {
+        errs() << "File checksums do not match: " << Checksum
+               << " != " << GCDAChecksum << ".\n";
+        return false;
+    }
+    for (const FunctionRecord &F: Functions) {
+        if (!Buff.readFunctionTag()) {
+            errs() << "Unexpected number of functions.\n";
+            return false;
+        }
+        if (!readFunctionGCDA(Buff, F, Weight)) return false;
+    }
+    // The object and program summaries that follow are not needed.
+    return true;
+}
+
+bool GCOVCounts::readFunctionGCDA(GCOVBuffer &Buff, const FunctionRecord &F,
+                                  uint64_t Weight) {
+    uint32_t Dummy;
+    if (!Buff.readInt(Dummy)) return false;  // Function header length
+
+    uint32_t GCDAIdent;
+    if (!Buff.readInt(GCDAIdent)) return false;
+    if (F.Ident != GCDAIdent) {
+        errs() << "Function identifiers do not match: " << F.Ident
+               << " != " << GCDAIdent << " (in " << F.Name << ").\n";
+        return false;
+    }
+    uint32_t GCDAChecksum;
+    if (!Buff.readInt(GCDAChecksum)) return false;
+    if (F.Checksum != GCDAChecksum) {
+        errs() << "Function checksums do not match: " << F.Checksum
+               << " != " << GCDAChecksum << " (in " << F.Name << ").\n";
+        return false;
+    }
+    if (Version != GCOV::V402) {
+        uint32_t CfgChecksum;
+        if (!Buff.readInt(CfgChecksum)) return false;
+        if (Checksum != CfgChecksum) {
+            errs() << "File checksums do not match: " << Checksum
+                   << " != " << CfgChecksum << " (in " << F.Name << ").\n";
+            return false;
+        }
+    }
+    StringRef GCDAName;
+    if (!Buff.readString(GCDAName)) return false;
+    if (F.Name != GCDAName) {
+        errs() << "Function names do not match: " << F.Name << " != "
+               << GCDAName << ".\n";
+        return false;
+    }
+    if (!Buff.readArcTag()) {
+        errs() << "Arc tag not found (in " << F.Name << ").\n";
+        return false;
+    }
+    uint32_t NumCounts;
+    if (!Buff.readInt(NumCounts)) return false;
+    NumCounts /= 2;
+    if (NumCounts != F.NumArcs) {
+        errs() << "Unexpected number of edges (in " << F.Name << ").\n";
+        return false;
+    }
+
+    // Like GCOVBlock::addCount, a block's count is the sum of its outgoing
+    // arcs; blocks without outgoing arcs count their incoming arcs instead.
+    uint64_t *BlockCounts = Counts.data() + F.FirstBlock;
+    const uint32_t *BlockNumDstArcs = NumDstArcs.data() + F.FirstBlock;
+    for (const Arc &A: makeArrayRef(Arcs).slice(F.FirstArc, F.NumArcs)) {
+        uint64_t ArcCount;
+        if (!Buff.readInt64(ArcCount)) return false;
+        ArcCount *= Weight;
+        BlockCounts[A.Src] += ArcCount;
+        if (!BlockNumDstArcs[A.Dst]) {
+            BlockCounts[A.Dst] += ArcCount;
+        }
+    }
+    return true;
+}
+
+GCOVCounts::FunctionBlocks
+GCOVCounts::getFunctionBlocks(StringRef Function) const {
+    auto I = FunctionsByName.find(Function);
+    if (I == FunctionsByName.end()) return FunctionBlocks();
+    const FunctionRecord &F = Functions[I->second];
+    return FunctionBlocks{
+        makeArrayRef(Counts).slice(F.FirstBlock, F.NumBlocks),
+        makeArrayRef(NumDstArcs).slice(F.FirstBlock, F.NumBlocks)};
+}
@@ -0,0 +1,87 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+// Block execution counts from GCOV data (.gcno and .gcda files).
+//
+// Unlike llvm::GCOVFile, which builds the full graph of GCOVBlocks and GCOVEdges
+// for printing coverage reports, GCOVCounts only keeps what is needed to
+// compute block counts: flat arrays of arcs and counts for all functions, and
+// function names that refer into the (memory-mapped) notes file.
+
+#ifndef SANITYCHECKS_GCOVCOUNTS_H
+#define SANITYCHECKS_GCOVCOUNTS_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/GCOV.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sanitychecks {
+
+/// GCOVCounts - The execution count of each GCOV block of each function.
+class GCOVCounts {
+public:
+    /// Reads the notes file. GCOVCounts keeps the buffer, since function
+    /// names refer into it.
+    bool readGCNO(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+    /// Adds the counts of a data file, multiplied by Weight. May be called
+    /// several times, after readGCNO, to merge the data of several runs.
+    bool readGCDA(llvm::MemoryBuffer &Buffer, uint64_t Weight = 1);
+
+    /// The GCOV blocks of a function, in the order of the notes file.
+    struct FunctionBlocks {
+        /// The execution count of each block.
+        llvm::ArrayRef<uint64_t> Counts;
+        /// The number of outgoing arcs of each block.
+        llvm::ArrayRef<uint32_t> NumDstArcs;
+    };
+
+    /// Returns the blocks of the named function, or empty arrays if the
+    /// function is unknown. Functions are indexed by name when the notes file
+    /// is read, so this is a single hash lookup.
+    FunctionBlocks getFunctionBlocks(llvm::StringRef Function) const;
+
+private:
+    struct FunctionRecord {
+        llvm::StringRef Name;
+        uint32_t Ident;
+        uint32_t Checksum;
+        // Ranges in Counts/NumDstArcs and in Arcs.
+        uint32_t FirstBlock, NumBlocks;
+        uint32_t FirstArc, NumArcs;
+    };
+
+    // An arc between two blocks of the same function, as indices into that
+    // function's blocks.
+    struct Arc {
+        uint32_t Src;
+        uint32_t Dst;
+    };
+
+    std::unique_ptr<llvm::MemoryBuffer> GCNO;
+    llvm::GCOV::GCOVVersion Version;
+    uint32_t Checksum = 0;
+
+    std::vector<FunctionRecord> Functions;
+    llvm::DenseMap<llvm::StringRef, unsigned> FunctionsByName;
+
+    // Arcs of all functions, sorted by source block within each function,
+    // i.e., in the order of their counts in the data files.
+    std::vector<Arc> Arcs;
+    std::vector<uint64_t> Counts;
+    std::vector<uint32_t> NumDstArcs;
+
+    bool readFunctionGCNO(llvm::GCOVBuffer &Buffer, FunctionRecord &F);
+    bool readFunctionGCDA(llvm::GCOVBuffer &Buffer, const FunctionRecord &F,
+                          uint64_t Weight);
+};
+
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_GCOVCOUNTS_H */
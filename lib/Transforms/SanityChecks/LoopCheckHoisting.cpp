@@ -0,0 +1,168 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "LoopCheckHoisting.h"
+#include "SanityCheckInstructionsPass.h"
+#include "utils.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#define DEBUG_TYPE "asap-hoist"
+
+using namespace llvm;
+using namespace sanitychecks;
+
+namespace {
+
+// Parses the name of an AddressSanitizer report function. Returns true and
+// sets IsWrite and Size if Name reports an access of a known size.
+bool parseAsanReport(const CallInst *CI, bool &IsWrite, uint64_t &Size) {
+    const Function *Callee = CI->getCalledFunction();
+    if (!Callee) return false;
+
+    StringRef Name = Callee->getName();
+    if (!Name.startswith("__asan_report_")) return false;
+    Name = Name.substr(strlen("__asan_report_"));
+
+    if (Name.startswith("load")) {
+        IsWrite = false;
+        Name = Name.substr(strlen("load"));
+    } else if (Name.startswith("store")) {
+        IsWrite = true;
+        Name = Name.substr(strlen("store"));
+    } else {
+        // E.g., __asan_report_exp_load4, whose extra argument we cannot
+        // pass on to the range check.
+        return false;
+    }
+
+    if (Name == "_n") {
+        const ConstantInt *C = dyn_cast<ConstantInt>(CI->getArgOperand(1));
+        if (!C) return false;
+        Size = C->getZExtValue();
+        return Size != 0;
+    }
+    return !Name.getAsInteger(10, Size) && Size != 0;
+}
+
+}  // anonymous namespace
+
+bool LoopCheckHoister::hoist(BranchInst *BI) {
+    BasicBlock *BB = BI->getParent();
+    Loop *L = LI.getLoopFor(BB);
+    if (!L) return false;
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Latch = L->getLoopLatch();
+    if (!Preheader || !Latch) return false;
+
+    unsigned int RegularBranch = getRegularBranch(BI, &SCI);
+    if (RegularBranch > 1) return false;
+    const CallInst *Report =
+        SCI.findSanityCheckCall(BI->getSuccessor(1 - RegularBranch));
+    bool IsWrite;
+    uint64_t AccessSize;
+    if (!Report || !parseAsanReport(Report, IsWrite, AccessSize)) return false;
+
+    // The report functions take the address as an integer.
+    Value *Addr = Report->getArgOperand(0);
+    if (PtrToIntInst *PTI = dyn_cast<PtrToIntInst>(Addr))
+        Addr = PTI->getOperand(0);
+    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Addr));
+    if (!AR || AR->getLoop() != L || !AR->isAffine() ||
+        !AR->getNoWrapFlags(SCEV::FlagNW)) {
+        return false;
+    }
+    const SCEVConstant *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    if (!Step || Step->getValue()->isZero()) return false;
+
+    // The access must happen in every iteration, including the last one,
+    // which ends at the exiting block. The access follows the check on its
+    // regular branch. For accesses of less than 8 bytes, BI is the slow path
+    // of the check, which only runs if the shadow byte is nonzero, so BB
+    // itself does not dominate the rest of the loop.
+    BasicBlock *AccessBB = BI->getSuccessor(RegularBranch);
+    BasicBlock *Exiting = getSingleExitingBlock(L);
+    if (!Exiting || !DT.dominates(AccessBB, Exiting) ||
+        !DT.dominates(AccessBB, Latch))
+        return false;
+    const SCEV *ExitCount = SE.getExitCount(L, Exiting);
+    if (isa<SCEVCouldNotCompute>(ExitCount) || containsCalls(L)) return false;
+
+    // The backedge is taken ExitCount times, so the access happens at
+    // Start + Step * I for I in [0, ExitCount].
+    const SCEV *First = AR->getStart();
+    const SCEV *Last = SE.getAddExpr(First, SE.getMulExpr(
+        SE.getTruncateOrZeroExtend(ExitCount, Step->getType()), Step));
+    bool Increasing = Step->getValue()->getValue().isStrictlyPositive();
+    const SCEV *Lo = Increasing ? First : Last;
+    const SCEV *Hi = Increasing ? Last : First;
+    if (!isSafeToExpand(Lo, SE) || !isSafeToExpand(Hi, SE)) return false;
+
+    Module *M = F.getParent();
+    const DataLayout &DL = M->getDataLayout();
+    Type *IntptrTy = DL.getIntPtrType(F.getContext());
+    Instruction *InsertPt = Preheader->getTerminator();
+
+    SCEVExpander Expander(SE, DL, "asap.hoist");
+    Value *LoV = Expander.expandCodeFor(Lo, IntptrTy, InsertPt);
+    Value *HiV = Expander.expandCodeFor(Hi, IntptrTy, InsertPt);
+
+    IRBuilder<> IRB(InsertPt);
+    Value *Size = IRB.CreateAdd(IRB.CreateSub(HiV, LoV),
+                                ConstantInt::get(IntptrTy, AccessSize));
+    Constant *RangeCheck = M->getOrInsertFunction(
+        IsWrite ? "__asan_storeN" : "__asan_loadN", IRB.getVoidTy(),
+        IntptrTy, IntptrTy, nullptr);
+    CallInst *CI = IRB.CreateCall(RangeCheck, {LoV, Size});
+    // Errors are reported at the location of the original access.
+    CI->setDebugLoc(getSanityCheckDebugLoc(BI, RegularBranch));
+
+    DEBUG(dbgs() << "Hoisted check of " << *Addr << " to " << *CI << "\n");
+    return true;
+}
+
+BasicBlock *LoopCheckHoister::getSingleExitingBlock(Loop *L) {
+    const SanityCheckInstructionsPass::BlockSet &CheckBlocks =
+        SCI.getSanityCheckBlocks(&F);
+
+    SmallVector<BasicBlock*, 8> ExitingBlocks;
+    L->getExitingBlocks(ExitingBlocks);
+
+    BasicBlock *Result = nullptr;
+    for (BasicBlock *BB: ExitingBlocks) {
+        bool LeavesLoop = false;
+        for (BasicBlock *Succ: successors(BB)) {
+            if (!L->contains(Succ) && !CheckBlocks.count(Succ)) {
+                LeavesLoop = true;
+            }
+        }
+        if (!LeavesLoop) continue;
+        if (Result) return nullptr;
+        Result = BB;
+    }
+    return Result;
+}
+
+bool LoopCheckHoister::containsCalls(Loop *L) {
+    for (BasicBlock *BB: L->getBlocks()) {
+        for (Instruction &I: *BB) {
+            CallSite CS(&I);
+            if (CS && !isa<IntrinsicInst>(&I)) return true;
+        }
+    }
+    return false;
+}
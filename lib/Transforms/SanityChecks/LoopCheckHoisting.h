@@ -0,0 +1,61 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+// Moves AddressSanitizer checks out of loops. A check on an access whose
+// address is an affine function of the loop's induction variable is replaced
+// by a single check of the whole address range, in the loop's preheader.
+
+#ifndef SANITYCHECKS_LOOPCHECKHOISTING_H
+#define SANITYCHECKS_LOOPCHECKHOISTING_H
+
+namespace llvm {
+    class BasicBlock;
+    class BranchInst;
+    class DominatorTree;
+    class Function;
+    class Loop;
+    class LoopInfo;
+    class ScalarEvolution;
+}
+
+struct SanityCheckInstructionsPass;
+
+namespace sanitychecks {
+
+/// LoopCheckHoister - Adds range checks to loop preheaders that cover the
+/// accesses of removed sanity checks.
+///
+/// The range is checked with __asan_loadN / __asan_storeN. A check is only
+/// hoisted if its access happens in every iteration, and the number of
+/// iterations is known before the loop is entered; otherwise the range check
+/// could report errors that the program never makes.
+class LoopCheckHoister {
+public:
+    LoopCheckHoister(llvm::Function &F, llvm::DominatorTree &DT,
+                     llvm::LoopInfo &LI, llvm::ScalarEvolution &SE,
+                     const SanityCheckInstructionsPass &SCI)
+        : F(F), DT(DT), LI(LI), SE(SE), SCI(SCI) {}
+
+    /// Adds a range check for the access checked by BI, which must be a
+    /// sanity check of F that has been removed. Returns true on success.
+    bool hoist(llvm::BranchInst *BI);
+
+private:
+    llvm::Function &F;
+    llvm::DominatorTree &DT;
+    llvm::LoopInfo &LI;
+    llvm::ScalarEvolution &SE;
+    const SanityCheckInstructionsPass &SCI;
+
+    // Returns the only block from which L can be left, other than through a
+    // sanity check, or nullptr if there are several.
+    llvm::BasicBlock *getSingleExitingBlock(llvm::Loop *L);
+
+    // Returns true if L contains calls, which might leave the loop early or
+    // change the state of the memory that the range check inspects.
+    bool containsCalls(llvm::Loop *L);
+};
+
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_LOOPCHECKHOISTING_H */
@@ -0,0 +1,172 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+
+#include "Multiversioning.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <algorithm>
+
+#define DEBUG_TYPE "asap-multiversion"
+
+using namespace llvm;
+using namespace sanitychecks;
+
+namespace {
+
+// Clones F into an internal function called F.<Suffix>. Debug information is
+// cloned as well, so that the variant gets its own subprogram.
+Function *cloneVariant(Function *F, StringRef Suffix) {
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(F, VMap, /*ModuleLevelChanges=*/true);
+    Clone->setName(F->getName() + "." + Suffix);
+    Clone->setLinkage(GlobalValue::InternalLinkage);
+    Clone->setVisibility(GlobalValue::DefaultVisibility);
+    Clone->setDLLStorageClass(GlobalValue::DefaultStorageClass);
+    F->getParent()->getFunctionList().push_back(Clone);
+    return Clone;
+}
+
+}  // anonymous namespace
+
+bool CheckMultiversioner::canMultiversion(const Function &F) {
+    if (F.isDeclaration() || F.isVarArg()) return false;
+    if (F.hasFnAttribute(Attribute::Naked)) return false;
+    // Arguments passed in the caller's frame cannot be forwarded.
+    for (const Argument &A: F.args()) {
+        if (A.hasInAllocaAttr()) return false;
+    }
+    return true;
+}
+
+void CheckMultiversioner::addFunction(Function *F) {
+    assert(canMultiversion(*F) && "Function cannot be multiversioned");
+    Variants V = {F, cloneVariant(F, "asap.checked")};
+    Functions.push_back(V);
+}
+
+void CheckMultiversioner::finish() {
+    for (Variants &V: Functions) {
+        Function *Unchecked = cloneVariant(V.Original, "asap.unchecked");
+        createDispatcher(V.Original, V.Checked, Unchecked);
+    }
+    Functions.clear();
+}
+
+GlobalVariable *CheckMultiversioner::getSamplingPeriod() {
+    if (Period) return Period;
+
+    LLVMContext &Ctx = M.getContext();
+    IntegerType *Int32Ty = Type::getInt32Ty(Ctx);
+    Period = new GlobalVariable(M, Int32Ty, false, GlobalValue::InternalLinkage,
+                                ConstantInt::get(Int32Ty, SamplingPeriod),
+                                "asap.sampling_period");
+
+    // Overrides the period with the value of ASAP_SAMPLING_PERIOD, if set to
+    // a positive number. With a period of zero, the counter would only match
+    // it when wrapping around.
+    Function *Init = Function::Create(
+        FunctionType::get(Type::getVoidTy(Ctx), false),
+        GlobalValue::InternalLinkage, "asap.init_sampling_period", &M);
+    Type *CharPtrTy = Type::getInt8PtrTy(Ctx);
+    Constant *GetEnv = M.getOrInsertFunction("getenv", CharPtrTy, CharPtrTy,
+                                             nullptr);
+    Constant *AToI = M.getOrInsertFunction("atoi", Int32Ty, CharPtrTy, nullptr);
+
+    BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", Init);
+    BasicBlock *Parse = BasicBlock::Create(Ctx, "parse", Init);
+    BasicBlock *Set = BasicBlock::Create(Ctx, "set", Init);
+    BasicBlock *Exit = BasicBlock::Create(Ctx, "exit", Init);
+    IRBuilder<> IRB(Entry);
+    Value *Name = IRB.CreateGlobalStringPtr("ASAP_SAMPLING_PERIOD");
+    Value *Env = IRB.CreateCall(GetEnv, Name);
+    IRB.CreateCondBr(IRB.CreateIsNull(Env), Exit, Parse);
+    IRB.SetInsertPoint(Parse);
+    Value *NewPeriod = IRB.CreateCall(AToI, Env);
+    IRB.CreateCondBr(IRB.CreateICmpSGT(NewPeriod, ConstantInt::get(Int32Ty, 0)),
+                     Set, Exit);
+    IRB.SetInsertPoint(Set);
+    IRB.CreateStore(NewPeriod, Period);
+    IRB.CreateBr(Exit);
+    IRB.SetInsertPoint(Exit);
+    IRB.CreateRetVoid();
+
+    // Use the default priority, so that sanitizer runtimes that intercept
+    // getenv or atoi are already initialized.
+    appendToGlobalCtors(M, Init, 65535);
+    return Period;
+}
+
+void CheckMultiversioner::createDispatcher(Function *F, Function *Checked,
+                                           Function *Unchecked) {
+    LLVMContext &Ctx = M.getContext();
+    IntegerType *Int32Ty = Type::getInt32Ty(Ctx);
+    GlobalVariable *PeriodVar = getSamplingPeriod();
+    GlobalVariable *Counter = new GlobalVariable(
+        M, Int32Ty, false, GlobalValue::InternalLinkage,
+        ConstantInt::get(Int32Ty, 0), F->getName() + ".asap.counter");
+
+    // The calls to the variants need a location in F, or they could not be
+    // inlined into F. Since F keeps none of its code, use its declaration.
+    DebugLoc DL;
+    if (DISubprogram *SP = getDISubprogram(F))
+        DL = DebugLoc::get(SP->getScopeLine(), 0, SP);
+
+    // Keep the attributes and debug information of F, but none of its code.
+    F->dropAllReferences();
+
+    BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", F);
+    BasicBlock *CheckedBB = BasicBlock::Create(Ctx, "checked", F);
+    BasicBlock *UncheckedBB = BasicBlock::Create(Ctx, "unchecked", F);
+
+    // Concurrent calls may lose increments of the counter, which only makes
+    // sampling less regular, so monotonic accesses suffice.
+    IRBuilder<> IRB(Entry);
+    IRB.SetCurrentDebugLocation(DL);
+    LoadInst *Count = IRB.CreateLoad(Counter);
+    Count->setAtomic(Monotonic);
+    Count->setAlignment(4);
+    LoadInst *N = IRB.CreateLoad(PeriodVar);
+    Value *Next = IRB.CreateAdd(Count, ConstantInt::get(Int32Ty, 1));
+    Value *Sample = IRB.CreateICmpEQ(Next, N);
+    StoreInst *Store = IRB.CreateStore(
+        IRB.CreateSelect(Sample, ConstantInt::get(Int32Ty, 0), Next), Counter);
+    Store->setAtomic(Monotonic);
+    Store->setAlignment(4);
+    MDBuilder MDB(Ctx);
+    IRB.CreateCondBr(Sample, CheckedBB, UncheckedBB,
+                     MDB.createBranchWeights(1, std::max(SamplingPeriod, 2u) - 1));
+
+    SmallVector<Value*, 8> Args;
+    for (Argument &A: F->args()) {
+        Args.push_back(&A);
+    }
+    bool CanTailCall = !F->getAttributes().hasAttrSomewhere(Attribute::ByVal);
+    for (BasicBlock *BB: {CheckedBB, UncheckedBB}) {
+        Function *Callee = BB == CheckedBB ? Checked : Unchecked;
+        IRB.SetInsertPoint(BB);
+        CallInst *CI = IRB.CreateCall(Callee, Args);
+        CI->setCallingConv(Callee->getCallingConv());
+        CI->setAttributes(Callee->getAttributes());
+        CI->setTailCall(CanTailCall);
+        if (F->getReturnType()->isVoidTy())
+            IRB.CreateRetVoid();
+        else
+            IRB.CreateRet(CI);
+    }
+
+    DEBUG(dbgs() << "Multiversioned " << F->getName() << "\n");
+}
@@ -0,0 +1,68 @@
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+// Splits functions into a checked and an unchecked variant. The original
+// function becomes a dispatcher that calls the checked variant once every N
+// calls, and the unchecked variant otherwise. N defaults to the value given
+// at compile time, and can be changed at run time through the
+// ASAP_SAMPLING_PERIOD environment variable. Periods must be positive;
+// other values of ASAP_SAMPLING_PERIOD are ignored.
+
+#ifndef SANITYCHECKS_MULTIVERSIONING_H
+#define SANITYCHECKS_MULTIVERSIONING_H
+
+#include <cassert>
+#include <vector>
+
+namespace llvm {
+    class Function;
+    class GlobalVariable;
+    class Module;
+}
+
+namespace sanitychecks {
+
+/// CheckMultiversioner - Creates checked and unchecked variants of functions.
+///
+/// Functions are added before any of their sanity checks are removed, which
+/// creates their checked variant. Once all of their checks have been removed,
+/// finish() turns what remains into the unchecked variant, and replaces the
+/// original function's body with the dispatcher.
+class CheckMultiversioner {
+public:
+    CheckMultiversioner(llvm::Module &M, unsigned SamplingPeriod)
+        : M(M), SamplingPeriod(SamplingPeriod), Period(nullptr) {
+        assert(SamplingPeriod > 0 && "Sampling period must be positive");
+    }
+
+    /// Returns true if F can be multiversioned.
+    static bool canMultiversion(const llvm::Function &F);
+
+    /// Creates the checked variant of F, which must still have all its checks.
+    void addFunction(llvm::Function *F);
+
+    /// Creates the unchecked variants and dispatchers of all added functions.
+    void finish();
+
+private:
+    llvm::Module &M;
+    unsigned SamplingPeriod;
+
+    // The period used by all dispatchers of the module. Created on demand,
+    // together with a constructor that reads it from the environment.
+    llvm::GlobalVariable *Period;
+
+    struct Variants {
+        llvm::Function *Original;
+        llvm::Function *Checked;
+    };
+    std::vector<Variants> Functions;
+
+    llvm::GlobalVariable *getSamplingPeriod();
+    void createDispatcher(llvm::Function *F, llvm::Function *Checked,
+                          llvm::Function *Unchecked);
+};
+
+}  // namespace sanitychecks
+
+#endif  /* SANITYCHECKS_MULTIVERSIONING_H */
@@ -11,10 +11,15 @@
 
 #include "SanityCheckCostPass.h"
 #include "SanityCheckInstructionsPass.h"
+#include "BlockProfile.h"
+#include "CostCalibration.h"
+#include "CostFile.h"
 #include "CostModel.h"
-#include "GCOV.h"
 #include "utils.h"
 
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
@@ -23,11 +28,14 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <algorithm>
 #include <memory>
 #include <system_error>
+#include <vector>
 #define DEBUG_TYPE "sanity-check-cost"
 
 using namespace llvm;
@@ -35,25 +43,148 @@ using namespace llvm;
 static cl::opt<std::string>
 InputGCNO("gcno", cl::desc("<input gcno file>"), cl::init(""), cl::Hidden);
 
+static cl::list<std::string>
+InputGCDA("gcda", cl::desc("<input gcda file>"), cl::ZeroOrMore, cl::Hidden);
+
+static cl::list<std::string>
+WeightedGCDA("asap-weighted-gcda",
+        cl::desc("<weight>,<gcda file>. Add the counts of this gcda file, "
+                 "multiplied by weight. Files given with --gcda have weight 1"),
+        cl::ZeroOrMore);
+
+static cl::opt<std::string>
+InputProfile("asap-profile",
+        cl::desc("Read block counts from this indexed instrumentation profile "
+                 "(.profdata) or sample profile, instead of --gcno and --gcda"),
+        cl::init(""));
+
+static cl::opt<std::string>
+OutputCostFile("asap-cost-file",
+        cl::desc("Write the costs of all sanity checks to this file, in "
+                 "ASAP's binary cost file format"),
+        cl::init(""));
+
+static cl::list<std::string>
+InputCostFiles("asap-load-costs",
+        cl::desc("Read the costs of sanity checks from binary cost files "
+                 "written by -asap-cost-file, instead of computing them from "
+                 "--gcno and --gcda. Directories are searched recursively "
+                 "for *.costs.bin files"),
+        cl::CommaSeparated);
+
 static cl::opt<std::string>
-InputGCDA("gcda", cl::desc("<input gcda file>"), cl::init(""), cl::Hidden);
+CalibrationFile("asap-calibration",
+        cl::desc("Use the measured check costs in this table, as written by "
+                 "asap-calibrate, instead of summing the estimated costs of "
+                 "each check's instructions"),
+        cl::init(""));
+
+static cl::opt<bool>
+SplitSharedCosts("asap-split-shared-costs",
+        cl::desc("Split the cost of instructions that are shared by several "
+                 "sanity checks evenly among these checks"),
+        cl::init(false));
 
 namespace {
     bool largerCost(const SanityCheckCostPass::CheckCost &a,
                      const SanityCheckCostPass::CheckCost &b) {
         return a.second > b.second;
     }
-}  // anonymous namespace
 
+    // The costs of the sanity checks in a single function, and of the
+    // instructions they consist of.
+    struct FunctionCosts {
+        std::vector<SanityCheckCostPass::CheckCost> CheckCosts;
+        DenseMap<Instruction*, uint64_t> InstructionCosts;
+        uint64_t BaselineCost = 0;
+    };
 
-bool SanityCheckCostPass::runOnModule(Module &M) {
-    SanityCheckInstructionsPass &SCI = getAnalysis<SanityCheckInstructionsPass>();
-    TargetTransformInfoWrapperPass &TTIWP = getAnalysis<TargetTransformInfoWrapperPass>();
-    std::unique_ptr<sanitychecks::GCOVFile> GF(createGCOVFile());
+    // Returns the static cost of an instruction, assuming a default cost of 1
+    // for unknown instructions.
+    unsigned getKnownInstructionCost(Instruction *I,
+                                     const TargetTransformInfo &TTI) {
+        unsigned Cost = sanitychecks::getInstructionCost(I, &TTI);
+        return Cost == (unsigned)(-1) ? 1 : Cost;
+    }
 
-    for (Function &F: M) {
+    // Estimates the cost of F without its sanity checks, i.e., the cost of
+    // all instructions that no check uses, times their execution count.
+    uint64_t computeBaselineCost(Function &F, const TargetTransformInfo &TTI,
+                                 const SanityCheckInstructionsPass &SCI,
+                                 const sanitychecks::BlockProfile &Profile) {
+        SmallPtrSet<Instruction*, 64> CheckInstructions;
+        for (Instruction *Inst: SCI.getSanityCheckBranches(&F)) {
+            for (Instruction *CI: SCI.getInstructionsBySanityCheck(Inst)) {
+                CheckInstructions.insert(CI);
+            }
+        }
+
+        uint64_t Cost = 0;
+        for (BasicBlock &BB: F) {
+            if (SCI.getSanityCheckBlocks(&F).count(&BB)) continue;
+            uint64_t Count = Profile.getCount(&BB);
+            if (Count == 0) continue;
+            for (Instruction &I: BB) {
+                if (CheckInstructions.count(&I)) continue;
+                Cost += getKnownInstructionCost(&I, TTI) * Count;
+            }
+        }
+        return Cost;
+    }
+
+    // Returns the measured cost of all executions of BI, or a negative value
+    // if Calibration has no entry for this kind of check. A check runs as
+    // often as its first block, which has the highest count of its blocks.
+    // For ASan checks of accesses smaller than 8 bytes, BI is the slow path,
+    // which only runs if the shadow byte is nonzero; each run of it adds the
+    // difference between the ":slow" entry and the fast path.
+    double getCalibratedCost(BranchInst *BI,
+                             const SanityCheckInstructionsPass &SCI,
+                             const sanitychecks::BlockProfile &Profile,
+                             const sanitychecks::CostCalibration &Calibration) {
+        unsigned int RegularBranch = getRegularBranch(BI, &SCI);
+        BasicBlock *CheckBlock = BI->getSuccessor(RegularBranch == 0 ? 1 : 0);
+        const CallInst *CI = SCI.findSanityCheckCall(CheckBlock);
+        if (!CI || !CI->getCalledFunction()) return -1.0;
+        StringRef Name = CI->getCalledFunction()->getName();
+        double Cycles = Calibration.getCost(Name);
+        if (Cycles < 0) return -1.0;
+
+        uint64_t BranchCount = Profile.getCount(BI->getParent());
+        uint64_t Count = BranchCount;
+        for (Instruction *I: SCI.getInstructionsBySanityCheck(BI)) {
+            Count = std::max(Count, Profile.getCount(I->getParent()));
+        }
+        double Cost = Cycles * Count;
+
+        double SlowCycles = Calibration.getCost((Name + ":slow").str());
+        if (Count != BranchCount && SlowCycles > Cycles) {
+            Cost += (SlowCycles - Cycles) * BranchCount;
+        }
+        DEBUG(dbgs() << "Calibrated sanity check: " << *BI
+                     << "\nCycles: " << Cycles
+                     << "\nCount: " << Count
+                     << "\nBranch count: " << BranchCount << "\n");
+        return Cost;
+    }
+
+    // Computes the costs for F, which must have been prepared in Profile.
+    void computeFunctionCosts(Function &F, const TargetTransformInfo &TTI,
+                              const SanityCheckInstructionsPass &SCI,
+                              const sanitychecks::BlockProfile &Profile,
+                              const sanitychecks::CostCalibration *Calibration,
+                              FunctionCosts &R) {
         DEBUG(dbgs() << "SanityCheckCostPass on " << F.getName() << "\n");
-        const TargetTransformInfo &TTI = TTIWP.getTTI(F);
+
+        // The number of checks using each instruction, to split its cost.
+        DenseMap<Instruction*, unsigned> NumChecksByInstruction;
+        if (SplitSharedCosts) {
+            for (Instruction *Inst: SCI.getSanityCheckBranches(&F)) {
+                for (Instruction *CI: SCI.getInstructionsBySanityCheck(Inst)) {
+                    NumChecksByInstruction[CI] += 1;
+                }
+            }
+        }
 
         for (Instruction *Inst: SCI.getSanityCheckBranches(&F)) {
             assert(Inst->getParent()->getParent() == &F && "SCI must only contain instructions of the current function.");
@@ -61,62 +192,247 @@ bool SanityCheckCostPass::runOnModule(Module &M) {
             BranchInst *BI = dyn_cast<BranchInst>(Inst);
             assert(BI && BI->isConditional() && "SanityCheckBranches must not contain instructions that aren't conditional branches.");
 
+            // A calibrated check costs its measured cycles every time it
+            // executes.
+            if (Calibration) {
+                double Cost = getCalibratedCost(BI, SCI, Profile,
+                                                *Calibration);
+                if (Cost >= 0) {
+                    R.CheckCosts.push_back(std::make_pair(
+                        BI, (uint64_t)(Cost + 0.5)));
+                    continue;
+                }
+            }
+
 #ifndef NDEBUG
             int nInstructions = 0;
             int nFreeInstructions = 0;
 #endif
             
             // The cost of a check is the sum of the cost of all instructions
-            // that this check uses.
-            // TODO: If an instruction is used by multiple checks, we need an
-            // intelligent way to handle the non linearity.
+            // that this check uses. By default, instructions used by multiple
+            // checks are counted fully for each of them; with
+            // -asap-split-shared-costs, each check gets an equal share.
             uint64_t Cost = 0;
+            double SplitCost = 0;
             for (Instruction *CI: SCI.getInstructionsBySanityCheck(BI)) {
-                unsigned CurrentCost = sanitychecks::getInstructionCost(CI, &TTI);
+                auto ICI = R.InstructionCosts.find(CI);
+                if (ICI == R.InstructionCosts.end()) {
+                    unsigned CurrentCost = getKnownInstructionCost(CI, TTI);
 
-                // Assume a default cost of 1 for unknown instructions
-                if (CurrentCost == (unsigned)(-1)) {
-                    CurrentCost = 1;
-                }
+                    DEBUG(
+                        if (CurrentCost == 0) {
+                            nFreeInstructions += 1;
+                        }
+                    );
 
-                DEBUG(
-                    if (CurrentCost == 0) {
-                        nFreeInstructions += 1;
-                    }
-                );
+                    assert(CurrentCost <= 100 && "Outlier cost value?");
 
-                assert(CurrentCost <= 100 && "Outlier cost value?");
+                    ICI = R.InstructionCosts.insert(
+                        std::make_pair(CI, CurrentCost * Profile.getCount(CI->getParent()))).first;
+                }
 
-                Cost += CurrentCost * GF->getCount(CI);
+                if (SplitSharedCosts) {
+                    SplitCost += (double)ICI->second / NumChecksByInstruction[CI];
+                } else {
+                    Cost += ICI->second;
+                }
                 DEBUG(nInstructions += 1) ;
             }
+            if (SplitSharedCosts) {
+                Cost = (uint64_t)(SplitCost + 0.5);
+            }
 
-            APInt CountInt = APInt(64, Cost);
-            MDNode *MD = MDNode::get(M.getContext(),
-                {ConstantAsMetadata::get(ConstantInt::get(
-                    Type::getInt64Ty(M.getContext()), CountInt))});
-            Inst->setMetadata("cost", MD);
-            CheckCosts.push_back(std::make_pair(BI, Cost));
+            R.CheckCosts.push_back(std::make_pair(BI, Cost));
 
             DEBUG(
                 dbgs() << "Sanity check: " << *BI << "\n";
                 unsigned int RegularBranch = getRegularBranch(BI, &SCI);
                 DebugLoc DL = getSanityCheckDebugLoc(BI, RegularBranch);
-                printDebugLoc(DL, M.getContext(), dbgs());
+                printDebugLoc(DL, F.getContext(), dbgs());
                 dbgs() << "\nnInstructions: " << nInstructions << "\n";
                 dbgs() << "nFreeInstructions: " << nFreeInstructions << "\n";
-                dbgs() << "Count: " << GF->getCount(BI) << "\n";
+                dbgs() << "Count: " << Profile.getCount(BI->getParent()) << "\n";
                 dbgs() << "Cost: " << Cost << "\n";
             );
         }
+
+        R.BaselineCost = computeBaselineCost(F, TTI, SCI, Profile);
+    }
+}  // anonymous namespace
+
+
+bool SanityCheckCostPass::runOnModule(Module &M) {
+    SanityCheckInstructionsPass &SCI = getAnalysis<SanityCheckInstructionsPass>();
+
+    if (!InputCostFiles.empty()) {
+        readCostFiles(SCI, M);
+    } else {
+        computeCosts(SCI, M);
+    }
+
+    // Attach metadata on the main thread; the LLVMContext is not thread-safe.
+    for (CheckCost &CC: CheckCosts) {
+        APInt CountInt = APInt(64, CC.second);
+        MDNode *MD = MDNode::get(M.getContext(),
+            {ConstantAsMetadata::get(ConstantInt::get(
+                Type::getInt64Ty(M.getContext()), CountInt))});
+        CC.first->setMetadata("cost", MD);
     }
 
     std::sort(CheckCosts.begin(), CheckCosts.end(), largerCost);
+
+    if (!OutputCostFile.empty()) {
+        writeCostFile(SCI, OutputCostFile);
+    }
     
     return false;
 }
 
+void SanityCheckCostPass::computeCosts(const SanityCheckInstructionsPass &SCI,
+                                       Module &M) {
+    TargetTransformInfoWrapperPass &TTIWP = getAnalysis<TargetTransformInfoWrapperPass>();
+    std::unique_ptr<sanitychecks::BlockProfile> Profile(createBlockProfile(M));
+
+    std::unique_ptr<sanitychecks::CostCalibration> Calibration;
+    if (!CalibrationFile.empty()) {
+        std::string Error;
+        Calibration = sanitychecks::CostCalibration::create(CalibrationFile, Error);
+        if (!Calibration) {
+            report_fatal_error(Error);
+        }
+    }
+
+    // Costs are computed on this thread, unlike the analysis in
+    // SanityCheckInstructionsPass: TargetTransformInfo queries create types
+    // (e.g., when legalizing vector types), and the LLVMContext is not
+    // thread-safe. Functions without checks contribute to the baseline cost.
+    for (Function &F: M) {
+        if (F.isDeclaration()) continue;
+        Profile->prepare(F, *this);
+        FunctionCosts R;
+        computeFunctionCosts(F, TTIWP.getTTI(F), SCI, *Profile,
+                             Calibration.get(), R);
+        InstructionCosts.insert(R.InstructionCosts.begin(), R.InstructionCosts.end());
+        CheckCosts.insert(CheckCosts.end(), R.CheckCosts.begin(), R.CheckCosts.end());
+        BaselineCost += R.BaselineCost;
+    }
+    // Measured costs cannot be attributed to individual instructions, and
+    // are not comparable to the baseline, which is estimated with TTI.
+    HasInstructionCosts = !Calibration;
+    HasBaselineCost = !Calibration;
+}
+
+namespace {
+    // Adds the costs in the given cost file to CostsByID, and its baseline
+    // cost to BaselineCost. All files must have been written with or
+    // without -asap-calibration, since their costs are in different units.
+    void addCostFile(StringRef Path, DenseMap<uint64_t, uint64_t> &CostsByID,
+                     uint64_t &BaselineCost, Optional<bool> &Calibrated) {
+        using sanitychecks::costfile::Reader;
+        using sanitychecks::costfile::Record;
+
+        ErrorOr<std::unique_ptr<Reader>> R = Reader::create(Path);
+        if (std::error_code EC = R.getError()) {
+            report_fatal_error(Path + ": " + EC.message());
+        }
+
+        bool FileCalibrated = R.get()->getHeader().Flags &
+                              sanitychecks::costfile::CalibratedCosts;
+        if (Calibrated.hasValue() && *Calibrated != FileCalibrated) {
+            report_fatal_error(Path + ": cannot mix cost files written with "
+                               "and without -asap-calibration");
+        }
+        Calibrated = FileCalibrated;
+
+        // A check can appear in several files, e.g., when it is part of an
+        // inline function that several translation units use. After linking,
+        // only one copy remains, and it runs as often as all copies together.
+        for (const Record &Rec: R.get()->records()) {
+            CostsByID[Rec.CheckID] += Rec.Cost;
+        }
+        BaselineCost += R.get()->getHeader().BaselineCost;
+    }
+}  // anonymous namespace
+
+void SanityCheckCostPass::readCostFiles(const SanityCheckInstructionsPass &SCI,
+                                        Module &M) {
+    DenseMap<uint64_t, uint64_t> CostsByID;
+    Optional<bool> Calibrated;
+    for (const std::string &Input: InputCostFiles) {
+        if (!sys::fs::is_directory(Input)) {
+            addCostFile(Input, CostsByID, BaselineCost, Calibrated);
+            continue;
+        }
+
+        std::error_code EC;
+        for (sys::fs::recursive_directory_iterator I(Input, EC), E;
+             I != E && !EC; I.increment(EC)) {
+            if (StringRef(I->path()).endswith(".costs.bin")) {
+                addCostFile(I->path(), CostsByID, BaselineCost, Calibrated);
+            }
+        }
+        if (EC) {
+            report_fatal_error(Input + ": " + EC.message());
+        }
+    }
+
+    HasBaselineCost = !Calibrated.getValueOr(false);
+
+    // Checks are identified by getSanityCheckID, which does not depend on
+    // anything that changes between the cost stage and this one, not even
+    // when LTO renames internal functions. Checks that the cost files do not
+    // know about are treated as never executed, but they are reported, since
+    // they usually mean that the cost files belong to another build.
+    size_t NumMissing = 0;
+    for (Function &F: M) {
+        for (Instruction *Inst: SCI.getSanityCheckBranches(&F)) {
+            BranchInst *BI = cast<BranchInst>(Inst);
+            auto CI = CostsByID.find(SCI.getSanityCheckID(BI));
+            if (CI == CostsByID.end()) {
+                NumMissing += 1;
+                CheckCosts.push_back(std::make_pair(BI, 0));
+            } else {
+                CheckCosts.push_back(std::make_pair(BI, CI->second));
+            }
+        }
+    }
+
+    DEBUG(dbgs() << "Read " << CostsByID.size() << " costs\n");
+    if (NumMissing > 0) {
+        dbgs() << "Warning: " << NumMissing << " out of " << CheckCosts.size()
+               << " sanity checks not found in the cost files; assuming "
+               << "they cost zero\n";
+    }
+}
+
+void SanityCheckCostPass::writeCostFile(const SanityCheckInstructionsPass &SCI,
+                                        StringRef Path) const {
+    std::vector<sanitychecks::costfile::Entry> Entries;
+    Entries.reserve(CheckCosts.size());
+    for (const CheckCost &I : CheckCosts) {
+        unsigned int RegularBranch = getRegularBranch(I.first, &SCI);
+        DebugLoc DL = getSanityCheckDebugLoc(I.first, RegularBranch);
+        std::string Location;
+        raw_string_ostream OS(Location);
+        printDebugLocChain(DL, I.first->getContext(), OS);
+        OS.flush();
+        Entries.push_back({I.second, SCI.getSanityCheckID(I.first), Location});
+    }
+
+    uint32_t Flags = 0;
+    if (!HasBaselineCost) {
+        Flags |= sanitychecks::costfile::CalibratedCosts;
+    }
+    std::error_code EC =
+        sanitychecks::costfile::writeCostFile(Path, Entries, BaselineCost, Flags);
+    if (EC) {
+        report_fatal_error(Path + ": " + EC.message());
+    }
+}
+
 void SanityCheckCostPass::getAnalysisUsage(AnalysisUsage& AU) const {
+    AU.addRequired<BlockFrequencyInfo>();
     AU.addRequired<TargetTransformInfoWrapperPass>();
     AU.addRequired<SanityCheckInstructionsPass>();
     AU.setPreservesAll();
@@ -124,6 +440,9 @@ void SanityCheckCostPass::getAnalysisUsage(AnalysisUsage& AU) const {
 
 void SanityCheckCostPass::print(raw_ostream &O, const Module *M) const {
     SanityCheckInstructionsPass &SCI = getAnalysis<SanityCheckInstructionsPass>();
+    if (HasBaselineCost) {
+        O << "Baseline cost: " << BaselineCost << "\n";
+    }
     O << "                Cost Location\n";
     for (const CheckCost &I : CheckCosts) {
         O << format("%20llu ", I.second);
@@ -134,36 +453,42 @@ void SanityCheckCostPass::print(raw_ostream &O, const Module *M) const {
     }
 }
 
-sanitychecks::GCOVFile *SanityCheckCostPass::createGCOVFile() {
-    sanitychecks::GCOVFile *GF = new sanitychecks::GCOVFile;
+std::unique_ptr<sanitychecks::BlockProfile>
+SanityCheckCostPass::createBlockProfile(Module &M) {
+    std::unique_ptr<sanitychecks::BlockProfile> Profile;
+    std::string Error;
 
-    if (InputGCNO.empty()) {
-        report_fatal_error("Need to specify --gcno!");
-    }
-    ErrorOr<std::unique_ptr<MemoryBuffer>> GCNO_Buff =
-        MemoryBuffer::getFileOrSTDIN(InputGCNO);
-    if (std::error_code EC = GCNO_Buff.getError()) {
-        report_fatal_error(InputGCNO + ":" + EC.message());
-    }
-    sanitychecks::GCOVBuffer GCNO_GB(GCNO_Buff.get().get());
-    if (!GF->readGCNO(GCNO_GB)) {
-        report_fatal_error(InputGCNO + ": Invalid .gcno file!");
+    if (!InputProfile.empty()) {
+        Profile = sanitychecks::BlockProfile::createFromProfile(
+            InputProfile, M.getContext(), Error);
+    } else {
+        if (InputGCNO.empty()) {
+            report_fatal_error("Need to specify --gcno or -asap-profile!");
+        }
+        std::vector<sanitychecks::WeightedFile> GCDAFiles;
+        for (const std::string &Path: InputGCDA) {
+            GCDAFiles.push_back({Path, 1});
+        }
+        for (StringRef Arg: WeightedGCDA) {
+            std::pair<StringRef, StringRef> WeightAndPath = Arg.split(',');
+            uint64_t Weight;
+            if (WeightAndPath.first.getAsInteger(10, Weight) ||
+                WeightAndPath.second.empty()) {
+                report_fatal_error("Invalid -asap-weighted-gcda argument: " + Arg);
+            }
+            GCDAFiles.push_back({WeightAndPath.second, Weight});
+        }
+        if (GCDAFiles.empty()) {
+            report_fatal_error("Need to specify --gcda or -asap-weighted-gcda!");
+        }
+        Profile = sanitychecks::BlockProfile::createFromGCOV(
+            InputGCNO, GCDAFiles, Error);
     }
 
-    if (InputGCDA.empty()) {
-        report_fatal_error("Need to specify --gcda!");
+    if (!Profile) {
+        report_fatal_error(Error);
     }
-    ErrorOr<std::unique_ptr<MemoryBuffer>> GCDA_Buff =
-        MemoryBuffer::getFileOrSTDIN(InputGCDA);
-    if (std::error_code EC = GCDA_Buff.getError()) {
-        report_fatal_error(InputGCDA + ":" + EC.message());
-    }
-    sanitychecks::GCOVBuffer GCDA_GB(GCDA_Buff.get().get());
-    if (!GF->readGCDA(GCDA_GB)) {
-        report_fatal_error(InputGCDA + ": Invalid .gcda file!");
-    }
-
-    return GF;
+    return Profile;
 }
 
 char SanityCheckCostPass::ID = 0;
@@ -1,24 +1,33 @@
 // This file is part of ASAP.
 // Please see LICENSE.txt for copyright and licensing information.
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
 
+#include <memory>
 #include <utility>
 #include <vector>
 
 namespace sanitychecks {
-    class GCOVFile;
+    class BlockProfile;
 }
 
 namespace llvm {
     class BranchInst;
+    class Instruction;
+    class Module;
+    class StringRef;
     class raw_ostream;
 }
 
+struct SanityCheckInstructionsPass;
+
 struct SanityCheckCostPass : public llvm::ModulePass {
     static char ID;
 
-    SanityCheckCostPass() : ModulePass(ID) {}
+    SanityCheckCostPass()
+        : ModulePass(ID), BaselineCost(0), HasBaselineCost(false),
+          HasInstructionCosts(false) {}
 
     virtual bool runOnModule(llvm::Module &M);
 
@@ -33,9 +42,54 @@ struct SanityCheckCostPass : public llvm::ModulePass {
         return CheckCosts;
     };
 
+    // Returns the dynamic cost (static cost times execution count) of an
+    // instruction belonging to a sanity check. Unlike the check costs, this
+    // is never split among the checks that share the instruction.
+    uint64_t getDynamicCost(llvm::Instruction *Inst) const {
+        return InstructionCosts.lookup(Inst);
+    }
+
+    // Returns the estimated cost of the program without its sanity checks,
+    // in the same unit as the check costs.
+    uint64_t getBaselineCost() const {
+        return BaselineCost;
+    }
+
+    // Returns false if the check costs were measured (-asap-calibration).
+    // The baseline cost is only estimated with TargetTransformInfo, so it
+    // cannot be compared with cycles.
+    bool hasBaselineCost() const {
+        return HasBaselineCost;
+    }
+
+    // Returns false if the check costs were read from a cost file, which
+    // does not contain costs of individual instructions, or were measured
+    // (-asap-calibration).
+    bool hasInstructionCosts() const {
+        return HasInstructionCosts;
+    }
+
 private:
 
     std::vector<CheckCost> CheckCosts;
+
+    llvm::DenseMap<llvm::Instruction *, uint64_t> InstructionCosts;
+    uint64_t BaselineCost;
+    bool HasBaselineCost;
+    bool HasInstructionCosts;
     
-    sanitychecks::GCOVFile *createGCOVFile();
+    // Reads block counts from -asap-profile, or from --gcno and --gcda.
+    std::unique_ptr<sanitychecks::BlockProfile> createBlockProfile(llvm::Module &M);
+
+    // Computes CheckCosts from the program's profile.
+    void computeCosts(const SanityCheckInstructionsPass &SCI, llvm::Module &M);
+
+    // Reads CheckCosts from the binary cost files given by -asap-load-costs,
+    // matching checks by their stable identifier. The files may belong to
+    // this module, or to the modules it was linked from.
+    void readCostFiles(const SanityCheckInstructionsPass &SCI, llvm::Module &M);
+
+    // Writes CheckCosts to a binary cost file (see CostFile.h).
+    void writeCostFile(const SanityCheckInstructionsPass &SCI,
+                       llvm::StringRef Path) const;
 };
@@ -4,68 +4,189 @@
 #include "SanityCheckInstructionsPass.h"
 #include "utils.h"
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Pass.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/IR/Module.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
 #define DEBUG_TYPE "sanity-check-instructions"
 
 using namespace llvm;
 
+namespace {
+    // Adds the sorted check numbers in Src to the sorted list Dst.
+    void mergeChecks(std::vector<unsigned> &Dst, const std::vector<unsigned> &Src) {
+        if (Src.empty()) return;
+        if (Dst.empty()) {
+            Dst = Src;
+            return;
+        }
+        std::vector<unsigned> Merged;
+        Merged.reserve(Dst.size() + Src.size());
+        std::set_union(Dst.begin(), Dst.end(), Src.begin(), Src.end(),
+                       std::back_inserter(Merged));
+        Dst.swap(Merged);
+    }
+}  // anonymous namespace
+
 bool SanityCheckInstructionsPass::runOnModule(Module &M) {
+    std::vector<Function*> Functions;
     for (Function &F: M) {
-        DEBUG(dbgs() << "SanityCheckInstructionsPass on " << F.getName() << "\n");
-        SanityCheckBlocks[&F] = BlockSet();
-        SanityCheckInstructions[&F] = InstructionSet();
-        SanityCheckBranches[&F] = InstructionSet();
-        findInstructions(&F);
-
-        MDNode *MD = MDNode::get(M.getContext(), {});
-        for (Instruction *Inst: SanityCheckInstructions[&F]) {
+        FunctionNumbers[&F] = Functions.size();
+        Functions.push_back(&F);
+    }
+
+    // Functions only refer to their own instructions, so they can be analyzed
+    // in parallel. Everything else happens on this thread, since neither the
+    // maps nor the LLVMContext are thread-safe. In particular, looking up
+    // metadata by name registers the name in the context if it is new, so
+    // the names that isAbortingCall uses are registered upfront.
+    M.getContext().getMDKindID("nosanitize");
+    Results.resize(Functions.size());
+    parallelFor(Functions.size(), [&](size_t I) {
+        DEBUG(dbgs() << "SanityCheckInstructionsPass on " << Functions[I]->getName() << "\n");
+        findInstructions(Functions[I], Results[I]);
+    });
+
+    MDNode *MD = MDNode::get(M.getContext(), {});
+    for (unsigned FN = 0, FE = Results.size(); FN != FE; ++FN) {
+        FunctionResult &R = Results[FN];
+        for (Instruction *Inst: R.Instructions) {
             Inst->setMetadata("sanitycheck", MD);
         }
+        std::vector<Instruction*>().swap(R.Instructions);
+
+        for (unsigned CN = 0, CE = R.Branches.size(); CN != CE; ++CN) {
+            CheckNumbers[R.Branches[CN]] = std::make_pair(FN, CN);
+        }
+    }
+
+    // Identifiers need the sanity check blocks of each function, and the
+    // compile unit of each function with debug info.
+    DenseMap<const Function*, std::pair<DICompileUnit*, DISubprogram*> > Subprograms;
+    if (NamedMDNode *CUNodes = M.getNamedMetadata("llvm.dbg.cu")) {
+        for (MDNode *N: CUNodes->operands()) {
+            DICompileUnit *CU = cast<DICompileUnit>(N);
+            for (DISubprogram *SP: CU->getSubprograms()) {
+                if (Function *F = SP->getFunction()) {
+                    Subprograms.insert(std::make_pair(F, std::make_pair(CU, SP)));
+                }
+            }
+        }
+    }
+
+    for (unsigned FN = 0, FE = Results.size(); FN != FE; ++FN) {
+        FunctionResult &R = Results[FN];
+        if (R.Branches.empty()) continue;
+        auto DI = Subprograms.lookup(Functions[FN]);
+        std::string FunctionKey =
+            getSanityCheckFunctionKey(*Functions[FN], DI.first, DI.second);
+        DenseMap<uint64_t, unsigned> Ordinals;
+        for (Instruction *Inst: R.Branches) {
+            BranchInst *BI = cast<BranchInst>(Inst);
+            unsigned int RegularBranch = getRegularBranch(BI, this);
+            uint64_t ID = ::getSanityCheckID(FunctionKey, BI, RegularBranch, 0);
+            unsigned Ordinal = Ordinals[ID]++;
+            if (Ordinal != 0) {
+                ID = ::getSanityCheckID(FunctionKey, BI, RegularBranch, Ordinal);
+            }
+            R.CheckIDs.push_back(ID);
+        }
     }
     
     return false;
 }
 
-void SanityCheckInstructionsPass::findInstructions(Function *F) {
+void SanityCheckInstructionsPass::findInstructions(Function *F,
+                                                   FunctionResult &R) const {
+
+    // Instructions get consecutive numbers as the search encounters them, so
+    // that everything we need to know about them can be kept in vectors
+    // indexed by number.
+    DenseMap<Instruction*, unsigned> Numbers;
+    std::vector<Instruction*> Instructions;
+
+    // The instructions found to belong to sanity checks so far.
+    BitVector IsSanityCheck;
+
+    // For each instruction, the sorted list of (numbers of) checks that use it.
+    std::vector<std::vector<unsigned> > ChecksByInstruction;
 
     // A list of instructions that are used by sanity checks. They become sanity
     // check instructions if it turns out they're not used by anything else.
-    SmallPtrSet<Instruction*, 128> Worklist;
-    
+    std::vector<unsigned> Worklist;
+    BitVector InWorklist;
+
     // A list of basic blocks that contain sanity check instructions. They
     // become sanity check blocks if it turns out they don't contain anything
     // else.
     SmallPtrSet<BasicBlock*, 64>   BlockWorklist;
-    
-    // A map from instructions to the checks that use them.
-    // RAHUL : Is this correct - why only 4?
-    std::map<Instruction*, SmallPtrSet<Instruction*, 4> > ChecksByInstruction;
+
+    auto getNumber = [&](Instruction *Inst) {
+        auto N = Numbers.insert(std::make_pair(Inst, (unsigned)Instructions.size()));
+        if (N.second) {
+            Instructions.push_back(Inst);
+            ChecksByInstruction.emplace_back();
+            IsSanityCheck.resize(Instructions.size());
+            InWorklist.resize(Instructions.size());
+        }
+        return N.first->second;
+    };
+    auto addToWorklist = [&](Instruction *Inst) {
+        unsigned N = getNumber(Inst);
+        if (!InWorklist[N]) {
+            InWorklist.set(N);
+            Worklist.push_back(N);
+        }
+        return N;
+    };
+    auto isSanityCheck = [&](Instruction *Inst) {
+        auto N = Numbers.find(Inst);
+        return N != Numbers.end() && IsSanityCheck[N->second];
+    };
+    auto onlyUsedInSanityChecks = [&](Instruction *Inst) {
+        for (User *U: Inst->users()) {
+            Instruction *UI = dyn_cast<Instruction>(U);
+            if (!UI || !isSanityCheck(UI)) return false;
+        }
+        return true;
+    };
 
     for (BasicBlock &BB: *F) {
         if (findSanityCheckCall(&BB)) {
-            SanityCheckBlocks[F].insert(&BB);
+            R.Blocks.insert(&BB);
 
             // All instructions inside sanity check blocks are sanity check instructions
             for (Instruction &I: BB) {
-                Worklist.insert(&I);
+                addToWorklist(&I);
             }
 
             // All branches to sanity check blocks are sanity check branches
             for (User *U: BB.users()) {
                 if (Instruction *Inst = dyn_cast<Instruction>(U)) {
-                    Worklist.insert(Inst);
+                    addToWorklist(Inst);
                 }
                 BranchInst *BI = dyn_cast<BranchInst>(U);
                 if (BI && BI->isConditional()) {
-                    SanityCheckBranches[F].insert(BI);
-                    ChecksByInstruction[BI].insert(BI);
+                    // A branch's own entry is empty until it is numbered as
+                    // a check, since checks only propagate to operands.
+                    std::vector<unsigned> &Checks = ChecksByInstruction[getNumber(BI)];
+                    if (Checks.empty()) {
+                        Checks.push_back(R.Branches.size());
+                        R.Branches.push_back(BI);
+                    }
                 }
             }
         }
@@ -74,34 +195,28 @@ void SanityCheckInstructionsPass::findInstructions(Function *F) {
     while (!Worklist.empty()) {
         // Alternate between emptying the worklist...
         while (!Worklist.empty()) {
-            Instruction *Inst = *Worklist.begin();
-            Worklist.erase(Inst);
-            if (onlyUsedInSanityChecks(Inst)) {
-                if (SanityCheckInstructions[F].insert(Inst).second) {
-                    for (Use &U: Inst->operands()) {
-                        if (Instruction *Op = dyn_cast<Instruction>(U.get())) {
-                            Worklist.insert(Op);
-                            
-                            // Copy ChecksByInstruction from Inst to Op
-                            // Rahul - Here they are copying the checks that use the parent instruction (user) into the map for this instruction
-                            auto CBI = ChecksByInstruction.find(Inst);
-                            if (CBI != ChecksByInstruction.end()) {
-                                ChecksByInstruction[Op].insert(CBI->second.begin(), CBI->second.end());
-                            }
-                        }
-                    }
+            unsigned N = Worklist.back();
+            Worklist.pop_back();
+            InWorklist.reset(N);
 
-                    BlockWorklist.insert(Inst->getParent());
+            Instruction *Inst = Instructions[N];
+            if (IsSanityCheck[N] || !onlyUsedInSanityChecks(Inst)) {
+                continue;
+            }
+            IsSanityCheck.set(N);
+
+            for (Use &U: Inst->operands()) {
+                if (Instruction *Op = dyn_cast<Instruction>(U.get())) {
+                    unsigned OpN = addToWorklist(Op);
 
-                    // Fill InstructionsBySanityCheck from the inverse ChecksByInstruction
-                    auto CBI = ChecksByInstruction.find(Inst);
-                    if (CBI != ChecksByInstruction.end()) {
-                        for (Instruction *CI : CBI->second) {
-                            InstructionsBySanityCheck[CI].insert(Inst);
-                        }
+                    // Operands are needed by all checks that need Inst.
+                    if (OpN != N) {
+                        mergeChecks(ChecksByInstruction[OpN], ChecksByInstruction[N]);
                     }
                 }
             }
+
+            BlockWorklist.insert(Inst->getParent());
         }
 
         // ... and checking whether this causes basic blocks to contain only
@@ -115,7 +230,7 @@ void SanityCheckInstructionsPass::findInstructions(Function *F) {
             
             bool allInstructionsAreSanityChecks = true;
             for (Instruction &I: *BB) {
-                if (!SanityCheckInstructions.at(BB->getParent()).count(&I)) {
+                if (!isSanityCheck(&I)) {
                     allInstructionsAreSanityChecks = false;
                     break;
                 }
@@ -124,12 +239,22 @@ void SanityCheckInstructionsPass::findInstructions(Function *F) {
             if (allInstructionsAreSanityChecks) {
                 for (User *U: BB->users()) {
                     if (Instruction *Inst = dyn_cast<Instruction>(U)) {
-                        Worklist.insert(Inst);
+                        addToWorklist(Inst);
                     }
                 }
             }
         }
     }
+
+    // Fill InstructionsBySanityCheck from the inverse ChecksByInstruction
+    R.InstructionsBySanityCheck.resize(R.Branches.size());
+    for (unsigned N = 0, E = Instructions.size(); N != E; ++N) {
+        if (!IsSanityCheck[N]) continue;
+        R.Instructions.push_back(Instructions[N]);
+        for (unsigned C: ChecksByInstruction[N]) {
+            R.InstructionsBySanityCheck[C].push_back(Instructions[N]);
+        }
+    }
 }
 
 const CallInst *SanityCheckInstructionsPass::findSanityCheckCall(BasicBlock* BB) const {
@@ -143,19 +268,6 @@ const CallInst *SanityCheckInstructionsPass::findSanityCheckCall(BasicBlock* BB)
     return 0;
 }
 
-bool SanityCheckInstructionsPass::onlyUsedInSanityChecks(Value* V) {
-    for (User *U: V->users()) {
-        Instruction *Inst = dyn_cast<Instruction>(U);
-        if (!Inst) return false;
-        
-        Function *F = Inst->getParent()->getParent();
-        if (!(SanityCheckInstructions[F].count(Inst))) {
-            return false;
-        }
-    }
-    return true;
-}
-
 char SanityCheckInstructionsPass::ID = 0;
 
 static RegisterPass<SanityCheckInstructionsPass> X("sanity-check-instructions",
@@ -1,10 +1,14 @@
 // This file is part of ASAP.
 // Please see LICENSE.txt for copyright and licensing information.
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Pass.h"
 
-#include <map>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 namespace llvm {
     class AnalysisUsage;
@@ -27,40 +31,72 @@ struct SanityCheckInstructionsPass : public llvm::ModulePass {
     }
 
     // Types used to store sanity check blocks / instructions
-    typedef llvm::SmallPtrSet<llvm::BasicBlock*, 64> BlockSet;
-    typedef llvm::SmallPtrSet<llvm::Instruction*, 64> InstructionSet;
+    typedef llvm::SmallPtrSet<llvm::BasicBlock*, 8> BlockSet;
+    typedef llvm::ArrayRef<llvm::Instruction*> InstructionList;
 
-    const InstructionSet &getSanityCheckBranches(llvm::Function *F) const {
-        return SanityCheckBranches.at(F);
+    InstructionList getSanityCheckBranches(llvm::Function *F) const {
+        return getResult(F).Branches;
     }
-    
+
     const BlockSet &getSanityCheckBlocks(llvm::Function *F) const {
-        return SanityCheckBlocks.at(F);
+        return getResult(F).Blocks;
+    }
+
+    InstructionList getInstructionsBySanityCheck(llvm::Instruction *Inst) const {
+        auto CN = CheckNumbers.find(Inst);
+        assert(CN != CheckNumbers.end() && "Not a sanity check branch");
+        return Results[CN->second.first].InstructionsBySanityCheck[CN->second.second];
     }
-    
-    const InstructionSet &getInstructionsBySanityCheck(llvm::Instruction *Inst) const {
-        return InstructionsBySanityCheck.at(Inst);
+
+    // Returns the stable identifier of a sanity check branch (see
+    // getSanityCheckID in utils.h).
+    uint64_t getSanityCheckID(llvm::Instruction *Inst) const {
+        auto CN = CheckNumbers.find(Inst);
+        assert(CN != CheckNumbers.end() && "Not a sanity check branch");
+        return Results[CN->second.first].CheckIDs[CN->second.second];
     }
 
     // Searches the given basic block for a call instruction that corresponds to
     // a sanity check and will abort the program (e.g., __assert_fail).
     const llvm::CallInst *findSanityCheckCall(llvm::BasicBlock *BB) const;
-    
+
 private:
 
-    // All blocks that abort due to sanity checks
-    std::map<llvm::Function*, BlockSet> SanityCheckBlocks;
-
-    // All instructions that belong to sanity checks
-    std::map<llvm::Function*, InstructionSet> SanityCheckInstructions;
-    
-    // All sanity checks themselves (branch instructions that could lead to an abort)
-    std::map<llvm::Function*, InstructionSet> SanityCheckBranches;
-    
-    // A map of all instructions required by a given sanity check branch.
-    // Note that instructions can belong to multiple sanity check branches.
-    std::map<llvm::Instruction*, InstructionSet> InstructionsBySanityCheck;
-
-    void findInstructions(llvm::Function *F);
-    bool onlyUsedInSanityChecks(llvm::Value *V);
+    // The sanity check blocks and instructions of a single function.
+    // Functions are analyzed independently, possibly on several threads.
+    struct FunctionResult {
+        // All blocks that abort due to sanity checks
+        BlockSet Blocks;
+
+        // All instructions that belong to sanity checks. Only needed until
+        // they are marked with metadata.
+        std::vector<llvm::Instruction*> Instructions;
+
+        // All sanity checks themselves (branch instructions that could lead
+        // to an abort). A check's index in this list is its check number.
+        std::vector<llvm::Instruction*> Branches;
+
+        // The instructions required by each sanity check branch, indexed by
+        // check number. Note that instructions can belong to multiple sanity
+        // check branches.
+        std::vector<std::vector<llvm::Instruction*> > InstructionsBySanityCheck;
+
+        // The stable identifier of each check, indexed by check number.
+        std::vector<uint64_t> CheckIDs;
+    };
+
+    // Results for all functions, in module order.
+    std::vector<FunctionResult> Results;
+    llvm::DenseMap<const llvm::Function*, unsigned> FunctionNumbers;
+
+    // The function number and check number of each sanity check branch.
+    llvm::DenseMap<const llvm::Instruction*, std::pair<unsigned, unsigned> > CheckNumbers;
+
+    const FunctionResult &getResult(llvm::Function *F) const {
+        auto FN = FunctionNumbers.find(F);
+        assert(FN != FunctionNumbers.end() && "Function not analyzed");
+        return Results[FN->second];
+    }
+
+    void findInstructions(llvm::Function *F, FunctionResult &R) const;
 };
@@ -3,6 +3,7 @@
 # This file is part of ASAP.
 # Please see LICENSE.txt for copyright and licensing information.
 
+require 'digest'
 require 'shellwords'
 
 SCRIPT_DIR = File.dirname($0)
@@ -21,6 +22,16 @@ def run!(*args)
   end
 end
 
+# Runs a command and returns its standard output
+def capture!(*args)
+  $stderr.puts Shellwords.join(args) if $VERBOSE
+  output = IO.popen(args, 'rb') { |io| io.read }
+  if not $?.success?
+    raise RunExternalCommandError, "Command #{args[0]} failed with status #{$?}"
+  end
+  output
+end
+
 # Finding stuff in the path
 # =========================
 
@@ -58,6 +69,12 @@ def find_llc()
   llc
 end
 
+def find_asap_threshold()
+  asap_threshold = $0.sub(/asap-clang(\+\+)?$/, 'asap-threshold')
+  raise "cannot find asap-threshold" if $0 == asap_threshold
+  asap_threshold
+end
+
 def find_ar()
   which('ar')
 end
@@ -125,6 +142,49 @@ def insert_arg(args, arg)
   [arg] + args
 end
 
+# Removes the arguments that name output files, or only affect them
+def remove_output_args(args)
+  result = []
+  skip_next = false
+  args.each do |a|
+    if skip_next
+      skip_next = false
+    elsif ['-o', '-MF', '-MT', '-MQ'].include?(a)
+      skip_next = true
+    elsif not ['-c', '-M', '-MM', '-MD', '-MMD', '-MP', '-MG'].include?(a)
+      result << a
+    end
+  end
+  result
+end
+
+# Computes a key that identifies the result of a compilation: a hash of the
+# compiler, the flags that affect the output, and the preprocessed source.
+def compute_cache_key(clang, args)
+  flags = remove_output_args(args)
+  digest = Digest::SHA256.new
+  ([clang] + flags).each { |a| digest << a << "\0" }
+  digest << capture!(clang, *flags, '-E', '-o', '-')
+  digest.hexdigest
+end
+
+# Returns true if the header of a binary cost file (see CostFile.h) has the
+# magic and version that this version of ASAP writes
+def cost_file_current?(costs_name)
+  header = IO.binread(costs_name, 12)
+  header && header[0, 8] == "ASAPCST\0" && header[8, 4].unpack('L<')[0] == 3
+end
+
+# Returns the number of checks in a binary cost file (see CostFile.h) that cost
+# at least threshold. Records are sorted by decreasing cost.
+def count_checks_costing_at_least(costs_name, threshold)
+  raise "invalid cost file: #{costs_name}" unless cost_file_current?(costs_name)
+  data = IO.binread(costs_name)
+  num_records = data[16, 8].unpack('Q<')[0]
+  cost_at = lambda { |i| data[48 + 24 * i, 8].unpack('Q<')[0] }
+  (0 ... num_records).bsearch { |i| cost_at.call(i) < threshold } || num_records
+end
+
 # Gets the optimization level, but sanitize it to one of the values that LLC understands
 def get_optlevel_for_llc(args)
   # Don't use /^-O.$/ here, because llc only knows numeric levels
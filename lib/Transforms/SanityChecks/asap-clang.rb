@@ -5,17 +5,42 @@
 #
 # - First step: -asap-init
 #   Creates the ASAP state directory, which contains all the additional files
-#   that ASAP manages throughout a compilation.
+#   that ASAP manages throughout a compilation. The cache of an existing state
+#   directory is kept.
 #   After asap-init, the software is ready to be compiled.
 # - Second step: -asap-coverage
 #   Prepares the compilation with coverage instrumentation. After this step,
 #   the software should be compiled again, and the resulting binary will be
 #   instrumented for coverage.
+#   Optionally, -asap-save-workload [-asap-workload-weight=<n>] after each
+#   representative run sets its coverage data aside, so that the next run
+#   starts from zero. The costs are then computed from the weighted sum of all
+#   saved workloads (and the last run).
 # - Third step: -asap-compute-costs
 #   Collects sanity checks and computes their costs
+#   With -asap-profile=<file>, costs are computed from an instrumentation
+#   profile (.profdata) or a sample profile of the initial build instead, and
+#   the coverage step can be skipped.
+#   With -asap-perf-data=<perf.data>, costs are computed from `perf record`
+#   samples of the initial build, mapped to source lines through its line
+#   tables. This also skips the coverage step.
 # - Fourth step: -asap-optimize
 #   Prepares for optimized compilation. Running make/ninja again after this
-#   should result in an optimized binary.
+#   should result in an optimized binary. The checks to keep are given by
+#   -asap-sanity-level, -asap-cost-level or -asap-overhead-budget=<percent>;
+#   the latter bounds the estimated cost of the remaining checks relative to
+#   the program without checks.
+#   With -asap-lto, objects are kept as bitcode and ASAP runs once per program
+#   at link time, inside the gold plugin, applying the level to the whole
+#   program.
+#   -asap-optimize can be repeated with another level; only the objects whose
+#   checks change are optimized again.
+# - After building the optimized version: -asap-report
+#   Collects the per-module reports of the cost and decision for each check
+#   into a single YAML file, e.g., for asap/scripts/report.
+#
+# Files are cached by the content of each translation unit, so rebuilding in a
+# later step (or with another level) only reruns the work whose inputs changed.
 
 # This file is part of ASAP.
 # Please see LICENSE.txt for copyright and licensing information.
@@ -23,6 +48,7 @@
 require 'fileutils'
 require 'parallel'
 require 'pathname'
+require 'yaml'
 
 require_relative 'asap-clang-utils.rb'
 
@@ -41,9 +67,13 @@ class AsapState
   def self.initialize_state()
     ENV['ASAP_STATE_PATH'] ||= File.realdirpath('asap_state')
 
+    # Cache entries are named after the contents of their translation units,
+    # so they stay valid and are kept; everything else is removed.
     if File.exist?(ENV['ASAP_STATE_PATH'])
-      $stderr.puts "Warning: removing old state folder #{ENV['ASAP_STATE_PATH']}" if $VERBOSE
-      FileUtils.rm_r(ENV['ASAP_STATE_PATH'])
+      $stderr.puts "Warning: removing old state in #{ENV['ASAP_STATE_PATH']}" if $VERBOSE
+      (Dir.entries(ENV['ASAP_STATE_PATH']) - ['.', '..', 'cache']).each do |f|
+        FileUtils.rm_r(File.join(ENV['ASAP_STATE_PATH'], f))
+      end
     end
 
     FileUtils.mkdir_p(ENV['ASAP_STATE_PATH'])
@@ -67,6 +97,16 @@ class AsapState
     end
   end
 
+  def workloads_directory()
+    File.join(state_path, 'workloads')
+  end
+
+  # Returns the folder where ASAP stores the files for the translation unit
+  # with the given cache key (see compute_cache_key)
+  def cache_path(key)
+    File.join(state_path, 'cache', key[0, 2], key)
+  end
+
   # Given two paths, returns the first path with all shared folders removed.
   # For example, /foo/bar/baz, /foo/quu => bar/baz
   #              /foo/bar/baz, /quu => foo/bar/baz
@@ -184,50 +224,58 @@ class AsapInitialCompiler < BaseCompiler
 
     target_name = get_arg(cmd, '-o')
 
-    # Yet another special case :(
-    # ASAP gets quite confused if the same file is used for different purposes
-    # throughout a build. Yet, configure calls all its tests "conftest.c"...
-    # just compile these normally.
-    # TODO: at some point, we might want to store the ASAP state objects with
-    # names that depend on the content of the source, rather than the object
-    # name.
-    return super if target_name =~ /conftest/
-
     if target_name and target_name.end_with?('.o')
       begin
-
-        gcno_name = mangle(state.coverage_path(target_name), '.o', '.gcno')
-        gcda_name = mangle(state.coverage_path(target_name), '.o', '.gcda')
-        orig_name = mangle(state.objects_path(target_name), '.o', '.orig.o')
-        FileUtils.mkdir_p(File.dirname(gcno_name))
-        FileUtils.mkdir_p(File.dirname(orig_name))
-
-        # Ensure that no target files exist. We had problems in the past with
-        # stale gcda files, that were then updated incorrectly.
-        FileUtils.rm_f([gcno_name, gcda_name, orig_name])
-
-        clang_args = cmd[1..-1]
-        clang_args = insert_arg(clang_args, '-gline-tables-only')
-        clang_args = insert_arg(clang_args, '-flto')
-        clang_args = ['-Xclang', '-femit-coverage-notes',
-                      '-Xclang', "-coverage-file=#{gcno_name}"] + clang_args
-
-        run!(clang, *clang_args)
-
-        # If this lead to an instrumented bitcode file, copy it.
-        # Also, run llc to generate a native object file instead of a bitcode file,
-        # in order to avoid LTO linking which is just too slow.
-        # We use the same optimization level for llc as for the original
-        # compilation.
-        if File.file?(gcno_name)
-          FileUtils.mv(target_name, orig_name)
+        # Files are stored in a cache entry named after the content of the
+        # translation unit, so that unchanged files are compiled only once,
+        # even if ASAP is restarted or the object name is reused (configure
+        # calls all its tests "conftest.c"...). The paths that the other
+        # stages use are links into the cache entry.
+        entry = state.cache_path(compute_cache_key(clang, cmd[1..-1]))
+        entry_gcno = File.join(entry, 'object.gcno')
+        entry_gcda = File.join(entry, 'object.gcda')
+        entry_orig = File.join(entry, 'orig.o')
+        entry_native = File.join(entry, 'native.o')
+
+        unless [entry_gcno, entry_orig, entry_native].all? { |f| File.file?(f) }
+          # Ensure that no stale files exist. We had problems in the past with
+          # stale gcda files, that were then updated incorrectly.
+          FileUtils.rm_rf(entry)
+          FileUtils.mkdir_p(entry)
+
+          clang_args = cmd[1..-1]
+          clang_args = insert_arg(clang_args, '-gline-tables-only')
+          clang_args = insert_arg(clang_args, '-flto')
+          clang_args = ['-Xclang', '-femit-coverage-notes',
+                        '-Xclang', "-coverage-file=#{entry_gcno}"] + clang_args
+
+          run!(clang, *clang_args)
+
+          # If this lead to an instrumented bitcode file, keep it.
+          # Also, run llc to generate a native object file instead of a bitcode file,
+          # in order to avoid LTO linking which is just too slow.
+          # We use the same optimization level for llc as for the original
+          # compilation.
+          return super unless File.file?(entry_gcno)
+          FileUtils.mv(target_name, entry_orig)
           opt_level = get_optlevel_for_llc(clang_args)
           run!(find_llc(), opt_level, '-filetype=obj', '-relocation-model=pic',
-               '-o', target_name, orig_name)
+               '-o', entry_native, entry_orig)
+        end
 
-          # If everthing so far worked, return happily
-          return
+        links = {
+          entry_gcno => mangle(state.coverage_path(target_name), '.o', '.gcno'),
+          entry_gcda => mangle(state.coverage_path(target_name), '.o', '.gcda'),
+          entry_orig => mangle(state.objects_path(target_name), '.o', '.orig.o'),
+        }
+        links.each do |src, dest|
+          FileUtils.mkdir_p(File.dirname(dest))
+          FileUtils.ln_sf(src, dest)
         end
+        FileUtils.cp(entry_native, target_name)
+
+        # If everthing so far worked, return happily
+        return
       rescue RunExternalCommandError
         # Nothing to do...
       end
@@ -252,14 +300,23 @@ class AsapProfilingCompiler < BaseCompiler
     orig_name = mangle(state.objects_path(target_name), '.o', '.orig.o')
     return super unless File.file?(orig_name)
 
-    # Original file exists; create the target from there
-    gcov_name = mangle(state.objects_path(target_name), '.o', '.gcov.o')
-    opt_level = get_optlevel_for_llc(cmd)
-    run!(find_opt(), '-insert-gcov-profiling',
-              '-o', gcov_name,
-              orig_name)
-    run!(find_llc(), opt_level, '-filetype=obj', '-relocation-model=pic',
-         '-o', target_name, gcov_name)
+    # Original file exists; create the target from there. The instrumented
+    # object only depends on the original one, so it is cached alongside.
+    # Counts from earlier runs are stale now.
+    entry = File.dirname(File.realpath(orig_name))
+    entry_coverage = File.join(entry, 'coverage.o')
+    FileUtils.rm_f(File.join(entry, 'object.gcda'))
+
+    unless File.file?(entry_coverage)
+      gcov_name = mangle(state.objects_path(target_name), '.o', '.gcov.o')
+      opt_level = get_optlevel_for_llc(cmd)
+      run!(find_opt(), '-insert-gcov-profiling',
+                '-o', gcov_name,
+                orig_name)
+      run!(find_llc(), opt_level, '-filetype=obj', '-relocation-model=pic',
+           '-o', entry_coverage, gcov_name)
+    end
+    FileUtils.cp(entry_coverage, target_name)
   end
 
   def do_link(cmd)
@@ -278,48 +335,106 @@ class AsapOptimizingCompiler < BaseCompiler
     threshold_file = IO.read(File.join(state.state_path, 'threshold'))
     raise "Threshold not defined" unless threshold_file =~ /^Cost threshold is (\d+)$/
     @cost_threshold = $1.to_i
+
+    lto_name = File.join(state.state_path, 'lto')
+    @lto_level = IO.read(lto_name).chomp if File.file?(lto_name)
   end
 
   def do_compile(cmd)
     target_name = get_arg(cmd, '-o')
     return super unless target_name and target_name.end_with?('.o')
 
-    # Check whether we have both an .orig.o file and coverage data. Otherwise,
-    # ASAP should not touch the current target.
+    # In LTO mode, the target is the unmodified bitcode file; checks are
+    # removed when linking.
     orig_name = mangle(state.objects_path(target_name), '.o', '.orig.o')
-    gcda_name = mangle(state.coverage_path(target_name), '.o', '.gcda')
-    gcno_name = mangle(state.coverage_path(target_name), '.o', '.gcno')
-    return super unless [orig_name, gcda_name, gcno_name].all? { |f| File.file?(f) }
+    if @lto_level
+      return super unless File.file?(orig_name)
+      FileUtils.cp(orig_name, target_name)
+      return
+    end
 
-    # Original file exists; create the target from there
-    asap_name = mangle(state.objects_path(target_name), '.o', '.asap.o')
-    opt_name = mangle(state.objects_path(target_name), '.o', '.asap.opt.o')
+    # Check whether we have both an .orig.o file and the costs computed from
+    # its coverage data. Otherwise, ASAP should not touch the current target.
+    costs_name = mangle(state.costs_path(target_name), '.o', '.costs.bin')
+    return super unless [orig_name, costs_name].all? { |f| File.file?(f) }
+
+    # Which checks are removed only depends on how many of the most costly
+    # checks cost at least the threshold, so the result can be reused for
+    # other thresholds that remove the same checks.
+    entry = File.dirname(File.realpath(orig_name))
+    num_removed = count_checks_costing_at_least(costs_name, @cost_threshold)
+    entry_asap = File.join(entry, "asap-#{num_removed}.o")
     log_name  = mangle(state.log_path(target_name), '.o', '.asap.log')
-    opt_level = get_optlevel_for_llc(cmd)
+    entry_log = File.join(entry, "asap-#{num_removed}.log")
+    report_name  = mangle(state.log_path(target_name), '.o', '.asap.yaml')
+    entry_report = File.join(entry, "asap-#{num_removed}.yaml")
+
+    unless [entry_asap, entry_report].all? { |f| File.file?(f) }
+      # Original file exists; create the target from there
+      asap_name = mangle(state.objects_path(target_name), '.o', '.asap.o')
+      opt_name = mangle(state.objects_path(target_name), '.o', '.asap.opt.o')
+      opt_level = get_optlevel_for_llc(cmd)
+      run!(find_opt(),
+           '-load', find_asap_lib(),
+           '-asap',
+           '-print-removed-checks',
+           "-asap-cost-threshold=#{@cost_threshold}",
+           "-asap-load-costs=#{costs_name}",
+           "-asap-report=#{entry_report}",
+           '-o', asap_name, orig_name,
+           :out => entry_log,
+           :err => [:child, :out])
+      run!(find_opt(),
+           opt_level, '-o', opt_name, asap_name)
+      run!(find_llc(), opt_level, '-filetype=obj', '-relocation-model=pic',
+           '-o', entry_asap, opt_name)
+    end
+
     FileUtils.mkdir_p(File.dirname(log_name))
-    run!(find_opt(),
-         '-load', find_asap_lib(),
-         '-asap',
-         '-print-removed-checks',
-         "-asap-cost-threshold=#{@cost_threshold}",
-         "-gcda=#{gcda_name}", "-gcno=#{gcno_name}",
-         '-o', asap_name, orig_name,
-         :out => log_name,
-         :err => [:child, :out])
-    run!(find_opt(),
-         opt_level, '-o', opt_name, asap_name)
-    run!(find_llc(), opt_level, '-filetype=obj', '-relocation-model=pic',
-         '-o', target_name, opt_name)
+    FileUtils.ln_sf(entry_log, log_name)
+    FileUtils.ln_sf(entry_report, report_name)
+    FileUtils.cp(entry_asap, target_name)
+  end
+
+  def do_link(cmd)
+    return super unless @lto_level
+
+    output_name = get_arg(cmd, '-o') || 'a.out'
+    report_name = "#{state.log_path(output_name)}.asap.yaml"
+    FileUtils.mkdir_p(File.dirname(report_name))
+    plugin_opts = ["load=#{find_asap_lib()}",
+                   '-asap-lto',
+                   "-asap-load-costs=#{state.costs_directory}",
+                   @lto_level,
+                   "-asap-program-name=#{File.basename(output_name)}",
+                   "-asap-report=#{report_name}"]
+    linker_args = cmd[1..-1]
+    linker_args = insert_arg(linker_args, '-fuse-ld=gold')
+    linker_args = insert_arg(linker_args, '-flto')
+    linker_args += plugin_opts.collect { |o| "-Wl,-plugin-opt=#{o}" }
+
+    super([cmd[0]] + linker_args)
   end
 end
 
 
 # Finds all sanity checks and computes their cost
-def compute_costs(state)
+def compute_costs(state, args)
+  profile = get_arg(args, '-asap-profile=')
+  return compute_costs_from_profile(state, File.expand_path(profile)) if profile
+
+  perf_data = get_arg(args, '-asap-perf-data=')
+  if perf_data
+    profile = File.join(state.state_path, 'perf.lineprof')
+    convert_perf_data(File.expand_path(perf_data), profile)
+    return compute_costs_from_profile(state, profile)
+  end
+
   gcda_files = []
   Dir.chdir(state.coverage_directory) do |coverage_dir|
     gcda_files = Dir.glob('**/*.gcda')
   end
+  workloads = saved_workloads(state)
 
   Parallel.each(gcda_files) do |gcda_basename|
     gcda_name = File.join(state.coverage_directory, gcda_basename)
@@ -327,89 +442,206 @@ def compute_costs(state)
     orig_name = mangle(File.join(state.objects_directory, gcda_basename), '.gcda', '.orig.o')
     costs_name = mangle(File.join(state.costs_directory, gcda_basename), '.gcda', '.costs')
 
-    FileUtils.mkdir_p(File.dirname(costs_name))
+    # The link exists even if the object was never executed
+    weighted_gcda = []
+    weighted_gcda << [1, gcda_name] if File.file?(gcda_name)
+    workloads.each do |dir, weight|
+      saved_gcda = File.join(dir, gcda_basename)
+      weighted_gcda << [weight, saved_gcda] if File.file?(saved_gcda)
+    end
+    next if weighted_gcda.empty?
 
-    run!(find_opt(),
-         '-load', find_asap_lib(),
-         '-analyze', '-sanity-check-cost',
-         "-gcda=#{gcda_name}", "-gcno=#{gcno_name}", orig_name,
-         :out => costs_name)
+    compute_object_costs(orig_name, costs_name,
+                         weighted_gcda.map { |_, f| f } + [gcno_name],
+                         weighted_gcda.map { |w, f| "-asap-weighted-gcda=#{w},#{f}" } +
+                         ["-gcno=#{gcno_name}"])
   end
 end
 
-# Obtains a cost threshold for the given sanity or cost level
-def compute_cost_threshold(state, args)
-  sanity_level = get_arg(args, '-asap-sanity-level=')
-  cost_level = get_arg(args, '-asap-cost-level=')
-  raise "specify -asap-cost-level or -asap-sanity-level" unless sanity_level or cost_level
-  raise "specify -asap-cost-level or -asap-sanity-level" if sanity_level and cost_level
-
-  # Read costs
-  costs = []
-  Dir.glob(File.join(state.costs_directory, '**', '*.costs')) do |cost_file|
-    open(cost_file, 'r') do |f|
-      f.each_line do |line|
-        if line =~ /^\s*(\d+)\s/
-          costs <<= $1.to_i
-        end
-      end
-    end
+# Returns [directory, weight] pairs for the workloads saved by
+# save_workload, in the order they were saved
+def saved_workloads(state)
+  Dir.glob(File.join(state.workloads_directory, '*', 'weight')).map do |f|
+    [File.dirname(f), Integer(IO.read(f).strip)]
+  end.sort_by { |dir, _| Integer(File.basename(dir)) }
+end
+
+# Moves the coverage data of the last run(s) into a new workload directory,
+# so that the next run starts from zero counts
+def save_workload(state, weight)
+  index = saved_workloads(state).map { |dir, _| Integer(File.basename(dir)) }.max
+  workload_dir = File.join(state.workloads_directory, ((index || -1) + 1).to_s)
+
+  gcda_files = []
+  Dir.chdir(state.coverage_directory) do |coverage_dir|
+    gcda_files = Dir.glob('**/*.gcda')
   end
-  raise "no costs found" if costs.empty?
 
-  # Sort by decreasing cost
-  costs.sort! { |a, b| b <=> a }
-  total_cost = costs.reduce(:+)
-  raise "all costs are zero" if total_cost == 0
+  num_saved = 0
+  gcda_files.each do |gcda_basename|
+    gcda_name = File.join(state.coverage_directory, gcda_basename)
+    next unless File.file?(gcda_name)
 
-  if sanity_level
-    sanity_level = sanity_level.to_f
-    cost_threshold = costs[0] + 1
+    saved_gcda = File.join(workload_dir, gcda_basename)
+    FileUtils.mkdir_p(File.dirname(saved_gcda))
+    FileUtils.mv(File.realpath(gcda_name), saved_gcda)
+    num_saved += 1
+  end
+  raise "no coverage data found; please run the program first" if num_saved == 0
 
-    (0 ... costs.size).each do |i|
-      next if costs[i+1] == costs[i]
-      # costs.size - i - 1 is the number of checks that will be left in the
-      # program, if we remove all those costing costs[i] or more.
-      if costs.size - i - 1 >= costs.size * sanity_level
-        cost_threshold = costs[i]
-      end
+  IO.write(File.join(workload_dir, 'weight'), "#{weight}\n")
+  puts "Saved coverage data of #{num_saved} objects as workload #{File.basename(workload_dir)} with weight #{weight}"
+end
+
+# Converts `perf record` data into a line profile (see BlockProfile.h), i.e.,
+# the number of samples per source line. perf resolves the addresses using the
+# line tables of the binary, which the initial build always has.
+def convert_perf_data(perf_data, profile_name)
+  samples = Hash.new(0)
+  args = ['perf', 'script', '-i', perf_data, '-F', 'ip,srcline']
+  $stderr.puts Shellwords.join(args) if $VERBOSE
+  IO.popen(args, 'r') do |io|
+    io.each_line do |line|
+      # Each sample is an address followed by its source location on the next
+      # line; addresses without line information are printed as "??:0".
+      next unless line =~ /^\s+(\S.*):(\d+)\s*$/
+      next if $2 == '0'
+      samples["#{$1}:#{$2}"] += 1
     end
+  end
+  raise RunExternalCommandError, "Command perf failed with status #{$?}" unless $?.success?
+  raise "no samples with line information found in #{perf_data}" if samples.empty?
 
-  elsif cost_level
-    cost_level = cost_level.to_f
-    cost_threshold = costs[0] + 1
-    removed_cost = 0
+  File.open(profile_name, 'w') do |out|
+    out.puts '# asap-line-profile'
+    samples.each { |location, count| out.puts "#{count} #{location}" }
+  end
+end
 
-    (0 ... costs.size).each do |i|
-      removed_cost += costs[i]
-      next if costs[i+1] == costs[i]
+# Same as compute_costs, but uses a profile of the whole program rather than
+# per-object coverage data
+def compute_costs_from_profile(state, profile)
+  orig_files = []
+  Dir.chdir(state.objects_directory) do |objects_dir|
+    orig_files = Dir.glob('**/*.orig.o')
+  end
 
-      # We never want to remove checks with cost zero
-      break if costs[i] == 0
+  Parallel.each(orig_files) do |orig_basename|
+    orig_name = File.join(state.objects_directory, orig_basename)
+    costs_name = mangle(File.join(state.costs_directory, orig_basename), '.orig.o', '.costs')
+
+    compute_object_costs(orig_name, costs_name, [profile],
+                         ["-asap-profile=#{profile}"])
+  end
+end
+
+# Computes the costs for a single object and links them to costs_name. Costs
+# are stored in the object's cache entry, and recomputed only if the profile
+# arguments changed or any of the inputs is newer. Optimized objects in the
+# entry are only named after the number of checks they remove, so they are
+# deleted when the costs change.
+def compute_object_costs(orig_name, costs_name, inputs, profile_args)
+  entry = File.dirname(File.realpath(orig_name))
+  entry_costs = File.join(entry, 'object.costs')
+  entry_costs_bin = File.join(entry, 'object.costs.bin')
+  entry_costs_args = File.join(entry, 'object.costs.args')
+
+  up_to_date = File.file?(entry_costs_bin) &&
+               cost_file_current?(entry_costs_bin) &&
+               File.file?(entry_costs_args) &&
+               IO.read(entry_costs_args) == profile_args.join("\n") &&
+               inputs.all? { |f| File.mtime(f) <= File.mtime(entry_costs_bin) }
+  unless up_to_date
+    FileUtils.rm_f(entry_costs_args)
+    FileUtils.rm_f(Dir.glob(File.join(entry, 'asap-*')))
+    run!(find_opt(),
+         '-load', find_asap_lib(),
+         '-analyze', '-sanity-check-cost',
+         "-asap-cost-file=#{entry_costs_bin}",
+         *profile_args, orig_name,
+         :out => entry_costs)
+    IO.write(entry_costs_args, profile_args.join("\n"))
+  end
+
+  FileUtils.mkdir_p(File.dirname(costs_name))
+  FileUtils.ln_sf(entry_costs, costs_name)
+  FileUtils.ln_sf(entry_costs_bin, "#{costs_name}.bin")
+end
 
-      # total_cost - removed_cost is the remaining cost.
-      if total_cost - removed_cost >= total_cost * cost_level
-        cost_threshold = costs[i]
+# Concatenates the reports of all modules into a YAML stream, preceded by a
+# summary document with the totals per kind of check
+def write_build_report(state, report_name)
+  module_reports = []
+  Dir.chdir(state.log_directory) do |log_dir|
+    module_reports = Dir.glob('**/*.asap.yaml').sort.map { |f| File.join(log_dir, f) }
+  end
+  module_reports.select! { |f| File.file?(f) }
+  raise "no ASAP reports found; please build the optimized version first" if module_reports.empty?
+
+  totals = Hash.new { |h, k| h[k] = Hash.new(0) }
+  module_reports.each do |f|
+    (YAML.load_file(f)['checks'] || []).each do |check|
+      [check['kind'], 'all'].each do |kind|
+        totals[kind]['total-checks'] += 1
+        totals[kind]['total-cost'] += check['cost']
+        # Sampled checks still run in the checked variants of their
+        # functions, so they are counted separately from removed ones.
+        case check['decision']
+        when 'removed', 'hoisted'
+          totals[kind]['removed-checks'] += 1
+          totals[kind]['removed-cost'] += check['cost']
+        when 'sampled'
+          totals[kind]['sampled-checks'] += 1
+          totals[kind]['sampled-cost'] += check['cost']
+        end
       end
     end
   end
 
-  # Print a summary of what we actually remove (numbers could differ from
-  # what's expected due to granularity issues)
-  removed_costs = costs.find_all { |c| c >= cost_threshold }
-  removed_cost = removed_costs.reduce(0, :+)
-
-  open(File.join(state.state_path, 'threshold'), 'w') do |threshold_file|
-    [threshold_file, $stdout].each do |f|
-      f.puts "Cost threshold is #{cost_threshold}"
-      f.puts "Removing %d out of %d static checks (%.2f%%)" % [removed_costs.size, costs.size,
-                                                               100.0 * removed_costs.size / costs.size]
-      f.puts "Removing %d out of %d dynamic checks (%.2f%%)" % [removed_cost, total_cost,
-                                                                100.0 * removed_cost / total_cost]
-    end
+  summary = totals['all'].merge('modules' => module_reports.size,
+                                'kinds' => totals.reject { |k, _| k == 'all' })
+  File.open(report_name, 'w') do |out|
+    out.write(YAML.dump(summary))
+    module_reports.each { |f| out.write(IO.read(f)) }
+  end
+
+  puts "Removed #{summary['removed-checks']} out of #{summary['total-checks']} static checks"
+  puts "Removed #{summary['removed-cost']} out of #{summary['total-cost']} dynamic checks"
+  if summary['sampled-checks'] > 0
+    puts "Sampled #{summary['sampled-checks']} more checks in multiversioned functions"
+  end
+  puts "Wrote report of #{module_reports.size} modules to #{report_name}"
+end
+
+# Translates -asap-sanity-level, -asap-cost-level or -asap-overhead-budget into
+# the corresponding option for asap-threshold and the ASAP pass
+def get_level_arg(args)
+  sanity_level = get_arg(args, '-asap-sanity-level=')
+  cost_level = get_arg(args, '-asap-cost-level=')
+  budget = get_arg(args, '-asap-overhead-budget=')
+  unless [sanity_level, cost_level, budget].compact.size == 1
+    raise "specify one of -asap-cost-level, -asap-sanity-level or -asap-overhead-budget"
   end
 
-  cost_threshold
+  if sanity_level then "-sanity-level=#{sanity_level.to_f}"
+  elsif cost_level then "-cost-level=#{cost_level.to_f}"
+  else "-asap-overhead-budget=#{budget.to_f}" end
+end
+
+# Obtains a cost threshold for the given sanity or cost level
+def compute_cost_threshold(state, args)
+  # asap-threshold merges the binary cost files written by compute_costs, and
+  # prints a summary of what we actually remove (numbers could differ from
+  # what's expected due to granularity issues)
+  level_arg = get_level_arg(args)
+  threshold_name = File.join(state.state_path, 'threshold')
+  run!(find_asap_threshold(), level_arg, state.costs_directory,
+       :out => threshold_name)
+
+  summary = IO.read(threshold_name)
+  $stdout.puts summary
+  raise "Threshold not defined" unless summary =~ /^Cost threshold is (\d+)$/
+  $1.to_i
 end
 
 # Some makefiles compile and link with a single command. We need to handle this
@@ -490,16 +722,30 @@ def main(argv)
       puts "Will build coverage-instrumented version on next rebuild; please run:"
       puts "make clean && make"
     end
+  elsif command == '-asap-save-workload'
+    state = AsapState.new
+    raise "coverage data can only be saved after -asap-coverage" unless state.current_state == :coverage
+    weight = Integer(get_arg(argv, '-asap-workload-weight=') || 1)
+    raise "workload weight must be positive" unless weight > 0
+    save_workload(state, weight)
   elsif command == '-asap-compute-costs'
     state = AsapState.new
-    state.transition(:coverage, :costs) do
+    # A profile replaces the coverage build
+    has_profile = get_arg(argv, '-asap-profile=') || get_arg(argv, '-asap-perf-data=')
+    from = if has_profile and state.current_state == :initial
+             :initial
+           else
+             :coverage
+           end
+    state.transition(from, :costs) do
       puts "Computing costs..."
-      compute_costs(state)
+      compute_costs(state, argv)
       puts "Done."
     end
   elsif command == '-asap-compute-threshold'
     state = AsapState.new
-    state.transition(:costs, :threshold) do
+    from = if state.current_state == :optimize then :optimize else :costs end
+    state.transition(from, :threshold) do
       compute_cost_threshold(state, argv)
     end
   elsif command == '-asap-optimize'
@@ -507,17 +753,31 @@ def main(argv)
 
     # Allow to fast-forward the state for convenience
     if state.current_state == :coverage
-      state.transition(:coverage, :costs) { compute_costs(state) }
+      state.transition(:coverage, :costs) { compute_costs(state, argv) }
     end
     if state.current_state == :costs
       state.transition(:costs, :threshold) { compute_cost_threshold(state, argv) }
     end
+    # Re-thresholding an optimized build reuses its costs
+    if state.current_state == :optimize
+      state.transition(:optimize, :threshold) { compute_cost_threshold(state, argv) }
+    end
 
     state.transition(:threshold, :optimize) do
+      lto_name = File.join(state.state_path, 'lto')
+      if get_arg(argv, '-asap-lto', :first)
+        IO.write(lto_name, "#{get_level_arg(argv)}\n")
+      else
+        FileUtils.rm_f(lto_name)
+      end
       puts "Will build optimized version on next rebuild; please run:"
       puts "make clean && make"
     end
 
+  elsif command == '-asap-report'
+    state = AsapState.new
+    raise "reports are only available after -asap-optimize" unless state.current_state == :optimize
+    write_build_report(state, File.expand_path(get_arg(argv, '-o') || File.join(state.state_path, 'report.yaml')))
   else
     raise "unknown command: #{command}"
   end
@@ -9,8 +9,17 @@
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 using namespace llvm;
 
 static cl::opt<bool>
@@ -23,28 +32,50 @@ OptimizeAssertions("asap-optimize-assertions",
         cl::desc("Should ASAP affect programmer-written assertions?"),
         cl::init(true));
 
+static cl::opt<unsigned>
+AnalysisThreads("asap-threads",
+        cl::desc("Number of threads used to analyze functions "
+                 "(0 = one per core)"),
+        cl::init(1));
+
 // Returns true if a given instruction is a call to an aborting, error reporting
 // function
 bool isAbortingCall(const CallInst *CI) {
+    StringRef Kind = getSanityCheckKind(CI);
+    if (Kind.empty()) {
+        return false;
+    }
+    if (Kind == "assert") {
+        return OptimizeAssertions;
+    }
+    return OptimizeSanityChecks;
+}
+
+StringRef getSanityCheckKind(const CallInst *CI) {
     if (CI->getCalledFunction()) {
         StringRef name = CI->getCalledFunction()->getName();
         if (name.startswith("__ubsan_") && name.endswith("_abort")) {
-            return OptimizeSanityChecks;
+            return "ubsan";
         }
         if (name.startswith("__softboundcets_") && name.endswith("_abort")) {
-            return OptimizeSanityChecks;
+            return "softbound";
         }
         if (name.startswith("__asan_report_")) {
-            return OptimizeSanityChecks;
+            return "asan";
         }
         if (name == "__assert_fail" || name == "__assert_rtn") {
-            return OptimizeAssertions;
+            return "assert";
+        }
+        // Traps inserted by instrumentation, such as -bounds-checking, are
+        // marked as such; other traps may be part of the program's logic.
+        if (name == "llvm.trap" && CI->getMetadata("nosanitize")) {
+            return "bounds";
         }
     }
-    return false;
+    return StringRef();
 }
 
-unsigned int getRegularBranch(BranchInst *BI, SanityCheckInstructionsPass *SCI) {
+unsigned int getRegularBranch(BranchInst *BI, const SanityCheckInstructionsPass *SCI) {
     unsigned int RegularBranch = (unsigned)(-1);
     Function *F = BI->getParent()->getParent();
     for (unsigned int I = 0, E = BI->getNumSuccessors(); I != E; ++I) {
@@ -92,3 +123,75 @@ void printDebugLoc(const DebugLoc& DbgLoc,
         Outs << ':' << DL->getColumn();
     }
 }
+
+void printDebugLocChain(const DebugLoc& DbgLoc,
+        LLVMContext &Ctx, raw_ostream &Outs) {
+    printDebugLoc(DbgLoc, Ctx, Outs);
+    for (DILocation *IA = DbgLoc ? DbgLoc.getInlinedAt() : nullptr; IA;
+            IA = IA->getInlinedAt()) {
+        Outs << " @ ";
+        printDebugLoc(DebugLoc(IA), Ctx, Outs);
+    }
+}
+
+std::string getSanityCheckFunctionKey(const Function &F,
+        const DICompileUnit *CU, const DISubprogram *SP) {
+    if (!F.hasLocalLinkage() || !CU || !SP) {
+        return F.getName();
+    }
+    StringRef Name = SP->getLinkageName();
+    if (Name.empty()) {
+        Name = SP->getName();
+    }
+    return (CU->getFilename() + ":" + Name).str();
+}
+
+uint64_t getSanityCheckID(StringRef FunctionKey, BranchInst *BI,
+        unsigned int RegularBranch, unsigned int Ordinal) {
+    SmallString<128> Key;
+    raw_svector_ostream OS(Key);
+    OS << FunctionKey << '\0';
+    printDebugLocChain(getSanityCheckDebugLoc(BI, RegularBranch),
+            BI->getContext(), OS);
+    OS << '\0' << Ordinal;
+
+    MD5 Hash;
+    Hash.update(OS.str());
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    return support::endian::read<uint64_t, support::little, support::unaligned>(Result);
+}
+
+void parallelFor(size_t N, const std::function<void(size_t)> &Fn) {
+    unsigned NumThreads = AnalysisThreads;
+    if (NumThreads == 0) {
+        NumThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (NumThreads > N) {
+        NumThreads = N;
+    }
+
+    if (NumThreads <= 1 || !llvm_is_multithreaded()) {
+        for (size_t I = 0; I < N; ++I) {
+            Fn(I);
+        }
+        return;
+    }
+
+    // Each worker repeatedly grabs the next index, which balances the load
+    // between large and small functions.
+    std::atomic<size_t> Next(0);
+    auto Worker = [&]() {
+        for (size_t I = Next++; I < N; I = Next++) {
+            Fn(I);
+        }
+    };
+    std::vector<std::thread> Threads;
+    for (unsigned T = 1; T < NumThreads; ++T) {
+        Threads.push_back(std::thread(Worker));
+    }
+    Worker();
+    for (std::thread &T: Threads) {
+        T.join();
+    }
+}
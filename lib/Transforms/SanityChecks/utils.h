@@ -4,11 +4,20 @@
 #ifndef SANITYCHECKS_UTILS_H
 #define	SANITYCHECKS_UTILS_H
 
+#include "llvm/ADT/StringRef.h"
 #include "llvm/IR/DebugLoc.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
 namespace llvm {
     class BranchInst;
     class CallInst;
+    class DICompileUnit;
+    class DISubprogram;
+    class Function;
     class LLVMContext;
     class raw_ostream;
 }
@@ -19,11 +28,18 @@ struct SanityCheckInstructionsPass;
 // function
 bool isAbortingCall(const llvm::CallInst *CI);
 
+// Returns the kind of sanity check ("asan", "ubsan", "softbound", "bounds" or
+// "assert") whose error reporting function CI calls, or an empty string if CI
+// is not such a call. "bounds" checks call llvm.trap with !nosanitize
+// metadata, as emitted by -bounds-checking. Unlike isAbortingCall, this
+// ignores the options that exclude some kinds from optimization.
+llvm::StringRef getSanityCheckKind(const llvm::CallInst *CI);
+
 // Returns the index of the regular branch of a sanity check, i.e., the branch
 // that continues program execution. Returns (unsigned) -1 if such a branch does
 // not exist.
 unsigned int getRegularBranch(llvm::BranchInst *BI,
-        SanityCheckInstructionsPass *SCI);
+        const SanityCheckInstructionsPass *SCI);
 
 // Returns the debug location of a sanity check.
 llvm::DebugLoc getSanityCheckDebugLoc(llvm::BranchInst *BI,
@@ -32,5 +48,30 @@ llvm::DebugLoc getSanityCheckDebugLoc(llvm::BranchInst *BI,
 void printDebugLoc(const llvm::DebugLoc& DbgLoc, llvm::LLVMContext &Ctx,
         llvm::raw_ostream &Outs);
 
+// Like printDebugLoc, but also prints the locations where the code has been
+// inlined, separated by " @ ".
+void printDebugLocChain(const llvm::DebugLoc& DbgLoc, llvm::LLVMContext &Ctx,
+        llvm::raw_ostream &Outs);
+
+// Returns the name of F for getSanityCheckID. Functions with local linkage
+// can be renamed when modules are linked (foo becomes foo.1), and functions of
+// different modules can have the same local name. Given F's debug info, such
+// functions are named after the main file of their compile unit CU and their
+// name in the source, which neither changes when linking nor collides.
+std::string getSanityCheckFunctionKey(const llvm::Function &F,
+        const llvm::DICompileUnit *CU, const llvm::DISubprogram *SP);
+
+// Returns an identifier for a sanity check that stays the same as long as the
+// code is compiled the same way. It is a hash of FunctionKey (see
+// getSanityCheckFunctionKey), the debug location of the check (including
+// where it has been inlined), and Ordinal, which distinguishes checks with the
+// same location.
+uint64_t getSanityCheckID(llvm::StringRef FunctionKey, llvm::BranchInst *BI,
+        unsigned int RegularBranch, unsigned int Ordinal);
+
+// Calls Fn(I) for every I in [0, N). The calls are shared among the number of
+// threads given by -asap-threads, and may thus run concurrently.
+void parallelFor(size_t N, const std::function<void(size_t)> &Fn);
+
 #endif	/* SANITYCHECKS_UTILS_H */
 
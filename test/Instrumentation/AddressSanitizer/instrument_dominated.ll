@@ -0,0 +1,85 @@
+; Test that AddressSanitizer does not instrument accesses that are dominated by
+; an instrumented access to the same address, unless memory may be freed in
+; between.
+; RUN: opt < %s -asan -asan-module -S | FileCheck %s
+; RUN: opt < %s -asan -asan-module -S -asan-opt-dominated=0 | FileCheck %s -check-prefix=NOOPT
+; RUN: opt < %s -asan -asan-module -S -asan-opt-dominated-max-candidates=0 | FileCheck %s -check-prefix=NOOPT
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i64 @strlen(i8*)
+declare void @free(i8*)
+
+define i32 @Dominated(i32* %a, i1 %c) sanitize_address {
+entry:
+  %t1 = load i32, i32* %a, align 4
+  br i1 %c, label %then, label %exit
+then:
+  store i32 0, i32* %a, align 4
+  br label %exit
+exit:
+  %t2 = load i32, i32* %a, align 4
+  ret i32 %t2
+}
+
+; CHECK-LABEL: @Dominated
+; CHECK: __asan_report_load4
+; CHECK-NOT: __asan_report_
+; CHECK: ret i32
+
+; NOOPT-LABEL: @Dominated
+; NOOPT: __asan_report_load4
+; NOOPT: __asan_report_store4
+; NOOPT: __asan_report_load4
+; NOOPT: ret i32
+
+define i8 @WiderFirst(i32* %a, i8* %s) sanitize_address {
+entry:
+  %t1 = load i32, i32* %a, align 4
+  %len = call i64 @strlen(i8* %s)
+  %p = bitcast i32* %a to i8*
+  %t2 = load i8, i8* %p, align 1
+  ret i8 %t2
+}
+
+; strlen does not free memory, and the first access covers the second one.
+; CHECK-LABEL: @WiderFirst
+; CHECK: __asan_report_load4
+; CHECK-NOT: __asan_report_
+; CHECK: ret i8
+
+define i32 @FreeOnPath(i32* %a, i8* %q, i1 %c) sanitize_address {
+entry:
+  %t1 = load i32, i32* %a, align 4
+  br i1 %c, label %then, label %exit
+then:
+  call void @free(i8* %q)
+  br label %exit
+exit:
+  %t2 = load i32, i32* %a, align 4
+  ret i32 %t2
+}
+
+; CHECK-LABEL: @FreeOnPath
+; CHECK: __asan_report_load4
+; CHECK: __asan_report_load4
+; CHECK: ret i32
+
+define void @FreeInLoop(i32* %a, i8* %q, i1 %c) sanitize_address {
+entry:
+  %t1 = load i32, i32* %a, align 4
+  br label %loop
+loop:
+  %t2 = load i32, i32* %a, align 4
+  call void @free(i8* %q)
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; The second access follows the free of the previous iteration.
+; CHECK-LABEL: @FreeInLoop
+; CHECK: __asan_report_load4
+; CHECK: __asan_report_load4
+; CHECK: ret void
@@ -0,0 +1,75 @@
+; RUN: opt < %s -bounds-checking -S | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+; The objects differ in size, but the access is in bounds for both of them.
+; CHECK-LABEL: @select_in_bounds
+define i32 @select_in_bounds(i1 %c) nounwind {
+  %a = alloca [2 x i32]
+  %b = alloca [4 x i32]
+  %pa = getelementptr inbounds [2 x i32], [2 x i32]* %a, i64 0, i64 1
+  %pb = getelementptr inbounds [4 x i32], [4 x i32]* %b, i64 0, i64 1
+  %p = select i1 %c, i32* %pa, i32* %pb
+; CHECK-NOT: trap
+  %v = load i32, i32* %p, align 4
+  ret i32 %v
+}
+
+; CHECK-LABEL: @select_out_of_bounds
+define i32 @select_out_of_bounds(i1 %c) nounwind {
+  %a = alloca [2 x i32]
+  %b = alloca [4 x i32]
+  %pa = getelementptr inbounds [2 x i32], [2 x i32]* %a, i64 0, i64 0
+  %pb = getelementptr inbounds [4 x i32], [4 x i32]* %b, i64 0, i64 0
+  %p = select i1 %c, i32* %pa, i32* %pb
+  %q = getelementptr inbounds i32, i32* %p, i64 3
+; CHECK: br i1 %{{.*}}, label %[[TRAP:.*]], label
+  %v = load i32, i32* %q, align 4
+  ret i32 %v
+; CHECK: [[TRAP]]:
+; CHECK-NEXT: call void @llvm.trap() {{.*}}!nosanitize
+}
+
+; CHECK-LABEL: @phi_in_bounds
+define i32 @phi_in_bounds(i1 %c) nounwind {
+entry:
+  %a = alloca [2 x i32]
+  %b = alloca [4 x i32]
+  br i1 %c, label %left, label %right
+
+left:
+  %pa = getelementptr inbounds [2 x i32], [2 x i32]* %a, i64 0, i64 0
+  br label %join
+
+right:
+  %pb = getelementptr inbounds [4 x i32], [4 x i32]* %b, i64 0, i64 2
+  br label %join
+
+join:
+  %p = phi i32* [ %pa, %left ], [ %pb, %right ]
+  %q = getelementptr inbounds i32, i32* %p, i64 1
+; CHECK-NOT: trap
+  %v = load i32, i32* %q, align 4
+  ret i32 %v
+}
+
+; A pointer advanced in a loop must still be checked.
+; CHECK-LABEL: @phi_loop
+define void @phi_loop(i64 %n) nounwind {
+entry:
+  %a = alloca [4 x i32]
+  %begin = getelementptr inbounds [4 x i32], [4 x i32]* %a, i64 0, i64 0
+  br label %loop
+
+loop:
+  %p = phi i32* [ %begin, %entry ], [ %next, %loop ]
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+; CHECK: call void @llvm.trap()
+  store i32 0, i32* %p, align 4
+  %next = getelementptr inbounds i32, i32* %p, i64 1
+  %inc = add i64 %i, 1
+  %done = icmp eq i64 %inc, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
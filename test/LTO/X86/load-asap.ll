@@ -0,0 +1,37 @@
+; Passes loaded with -load can add themselves to the LTO pipeline. ASAP does
+; so with -asap-lto, using the costs that were computed for each object.
+; RUN: llvm-as %s -o %t.bc
+; RUN: rm -rf %t.costs && mkdir -p %t.costs
+; RUN: echo '# asap-line-profile' > %t.prof
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -sanity-check-cost \
+; RUN:   -asap-profile=%t.prof -asap-cost-file=%t.costs/a.costs.bin \
+; RUN:   -disable-output %s
+; RUN: llvm-lto -load=%llvmshlibdir/SanityChecks%shlibext -asap-lto \
+; RUN:   -asap-load-costs=%t.costs -sanity-level=0 -exported-symbol=foo \
+; RUN:   -o %t.o %t.bc 2>&1 | FileCheck %s -check-prefix=ASAP
+; RUN: llvm-nm %t.o | FileCheck %s -check-prefix=REMOVED
+; RUN: llvm-lto -exported-symbol=foo -o %t2.o %t.bc
+; RUN: llvm-nm %t2.o | FileCheck %s -check-prefix=KEPT
+; REQUIRES: loadable_module
+
+; ASAP: Removed 1 out of 1 static checks
+; REMOVED-NOT: __assert_fail
+; KEPT: U __assert_fail
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @foo(i32 %x) {
+entry:
+  %c = icmp slt i32 %x, 10
+  br i1 %c, label %ok, label %fail
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null)
+  unreachable
+
+ok:
+  ret i32 %x
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
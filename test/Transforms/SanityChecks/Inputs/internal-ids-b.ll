@@ -0,0 +1,38 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @b(i32 %x) {
+entry:
+  %r = call i32 @foo(i32 %x)
+  ret i32 %r
+}
+
+define internal i32 @foo(i32 %x) {
+entry:
+  %c = icmp slt i32 %x, 10, !dbg !9
+  br i1 %c, label %ok, label %fail, !dbg !9
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null), !dbg !9
+  unreachable
+
+ok:
+  ret i32 %x, !dbg !10
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "b.c", directory: "/tmp")
+!2 = !{!3}
+!3 = !DISubprogram(name: "foo", scope: !8, file: !8, line: 1, type: !4, isLocal: true, isDefinition: true, scopeLine: 1, isOptimized: false, function: i32 (i32)* @foo, variables: !6)
+!4 = !DISubroutineType(types: !5)
+!5 = !{null}
+!6 = !{}
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!8 = !DIFile(filename: "h.h", directory: "/tmp")
+!9 = !DILocation(line: 2, column: 3, scope: !3)
+!10 = !DILocation(line: 3, column: 3, scope: !3)
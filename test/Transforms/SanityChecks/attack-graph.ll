@@ -0,0 +1,59 @@
+; Test that -asap-attack-graph reads the attack graph from a file, and that
+; checks of accesses the attack graph does not reach are removed even at
+; -sanity-level=1.
+; RUN: echo '# asap-line-profile' > %t.prof
+; RUN: echo '100 ag.c:5' >> %t.prof
+; RUN: echo '10 ag.c:6' >> %t.prof
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -sanity-level=1 \
+; RUN:   -asap-profile=%t.prof -asap-program-name=ag \
+; RUN:   -asap-attack-graph=%S/Inputs/attack-graph.tsv -S %s 2>&1 | FileCheck %s
+; REQUIRES: loadable_module
+
+; The facts of other programs are ignored, so the store to %p is safe.
+; CHECK: Removed 1 out of 2 static checks
+; CHECK-LABEL: define void @store2(i32 %x, i32* %p, i32* %q)
+; CHECK: br i1 true, label %ok.p, label %fail
+; The store to %q is listed, although it has a !dbg attachment in this module.
+; CHECK: br i1 %cq, label %ok.q, label %fail
+; CHECK: store i32 %x, i32* %q, align 4, !dbg
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @store2(i32 %x, i32* %p, i32* %q) {
+entry:
+  %cp = icmp ne i32* %p, null, !dbg !9
+  br i1 %cp, label %ok.p, label %fail, !dbg !9
+
+ok.p:
+  store i32 %x, i32* %p, align 4, !dbg !9
+  br label %check.q, !dbg !9
+
+check.q:
+  %cq = icmp ne i32* %q, null, !dbg !10
+  br i1 %cq, label %ok.q, label %fail, !dbg !10
+
+ok.q:
+  store i32 %x, i32* %q, align 4, !dbg !10
+  ret void, !dbg !10
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null), !dbg !9
+  unreachable
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "ag.c", directory: "/tmp")
+!2 = !{!3}
+!3 = !DISubprogram(name: "store2", scope: !1, file: !1, line: 3, type: !4, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: false, function: void (i32, i32*, i32*)* @store2, variables: !6)
+!4 = !DISubroutineType(types: !5)
+!5 = !{null}
+!6 = !{}
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!9 = !DILocation(line: 5, column: 3, scope: !3)
+!10 = !DILocation(line: 6, column: 3, scope: !3)
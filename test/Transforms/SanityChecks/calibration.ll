@@ -0,0 +1,98 @@
+; Test that -asap-calibration weights the measured cost of a check by the
+; count of its first block, and adds the ":slow" entry for the slow path of
+; ASan checks of less than 8 bytes, which runs less often.
+; RUN: echo '# asap-line-profile' > %t.prof
+; RUN: echo '100 calibration.c:2' >> %t.prof
+; RUN: echo '10 calibration.c:3' >> %t.prof
+; RUN: echo '100 calibration.c:5' >> %t.prof
+; RUN: echo '# asap-calibrate, test' > %t.cal
+; RUN: echo '' >> %t.cal
+; RUN: echo '__asan_report_store4 2.0' >> %t.cal
+; RUN: echo '__asan_report_store4:slow 5.0' >> %t.cal
+; RUN: echo '__asan_report_store8  1.5' >> %t.cal
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -cost-level=0 \
+; RUN:   -asap-profile=%t.prof -asap-calibration=%t.cal -print-removed-checks \
+; RUN:   -disable-output %s 2>&1 | FileCheck %s
+; RUN: echo '__asan_report_store4 2.0' > %t.bad.cal
+; RUN: echo '__asan_report_store8' >> %t.bad.cal
+; RUN: not opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -cost-level=0 \
+; RUN:   -asap-profile=%t.prof -asap-calibration=%t.bad.cal -disable-output \
+; RUN:   %s 2>&1 | FileCheck %s -check-prefix=INVALID
+; REQUIRES: loadable_module
+
+; The 4-byte check runs 100 times, and takes its slow path 10 times:
+; 2.0 * 100 + (5.0 - 2.0) * 10 = 230.
+; CHECK-DAG: calibration.c:3:3: SanityCheck with cost i64 230
+; CHECK-DAG: calibration.c:5:3: SanityCheck with cost i64 150
+; CHECK: Removed 2 out of 2 static checks
+; CHECK-NEXT: Removed 380 out of 380 dynamic checks
+
+; INVALID: bad.cal:2: expected a function name and a cost
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @store_i32(i32* %p) sanitize_address {
+entry:
+  %0 = ptrtoint i32* %p to i64, !dbg !9
+  %1 = lshr i64 %0, 3, !dbg !9
+  %2 = add i64 %1, 2147450880, !dbg !9
+  %3 = inttoptr i64 %2 to i8*, !dbg !9
+  %4 = load i8, i8* %3, !dbg !9
+  %5 = icmp ne i8 %4, 0, !dbg !9
+  br i1 %5, label %slow, label %access, !dbg !9
+
+slow:
+  %6 = and i64 %0, 7, !dbg !11
+  %7 = add i64 %6, 3, !dbg !11
+  %8 = trunc i64 %7 to i8, !dbg !11
+  %9 = icmp sge i8 %8, %4, !dbg !11
+  br i1 %9, label %report, label %access, !dbg !11
+
+report:
+  call void @__asan_report_store4(i64 %0), !dbg !9
+  call void asm sideeffect "", ""()
+  unreachable
+
+access:
+  store i32 0, i32* %p, align 4, !dbg !9
+  ret void, !dbg !9
+}
+
+define void @store_i64(i64* %p) sanitize_address {
+entry:
+  %0 = ptrtoint i64* %p to i64, !dbg !10
+  %1 = lshr i64 %0, 3, !dbg !10
+  %2 = add i64 %1, 2147450880, !dbg !10
+  %3 = inttoptr i64 %2 to i8*, !dbg !10
+  %4 = load i8, i8* %3, !dbg !10
+  %5 = icmp ne i8 %4, 0, !dbg !10
+  br i1 %5, label %report, label %access, !dbg !10
+
+report:
+  call void @__asan_report_store8(i64 %0), !dbg !10
+  call void asm sideeffect "", ""(), !dbg !10
+  unreachable, !dbg !10
+
+access:
+  store i64 0, i64* %p, align 8, !dbg !10
+  ret void, !dbg !10
+}
+
+declare void @__asan_report_store4(i64)
+declare void @__asan_report_store8(i64)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "calibration.c", directory: "/tmp")
+!2 = !{!3, !4}
+!3 = !DISubprogram(name: "store_i32", scope: !1, file: !1, line: 1, type: !6, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: false, function: void (i32*)* @store_i32, variables: !8)
+!4 = !DISubprogram(name: "store_i64", scope: !1, file: !1, line: 4, type: !6, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: false, function: void (i64*)* @store_i64, variables: !8)
+!6 = !DISubroutineType(types: !8)
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!8 = !{}
+!9 = !DILocation(line: 2, column: 3, scope: !3)
+!10 = !DILocation(line: 5, column: 3, scope: !4)
+!11 = !DILocation(line: 3, column: 3, scope: !3)
@@ -0,0 +1,114 @@
+; Test that -asap-hoist-checks replaces removed AddressSanitizer checks in loops
+; by a range check before the loop, for accesses of any size, but only if the
+; access happens in every iteration.
+; RUN: echo '# asap-line-profile' > %t.prof
+; RUN: echo '100 hoist.c:2' >> %t.prof
+; RUN: echo '100 hoist.c:5' >> %t.prof
+; RUN: echo '100 hoist.c:8' >> %t.prof
+; RUN: opt -loop-simplify -asan %s -o %t.asan.bc
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -sanity-level=0 \
+; RUN:   -asap-hoist-checks -asap-profile=%t.prof %t.asan.bc -S -o %t.ll 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=STATS
+; RUN: FileCheck %s < %t.ll
+; REQUIRES: loadable_module
+
+; STATS: Removed 3 out of 3 static checks
+; STATS: Hoisted 2 out of 3 removed checks out of loops
+
+; For 4-byte accesses, the check that ASAP removes is the slow path, which
+; only runs if the shadow byte is nonzero.
+; CHECK-LABEL: define void @store_i32(
+; CHECK: loop.preheader:
+; CHECK: [[SIZE32:%[0-9]+]] = add i64 %{{[0-9]+}}, 4
+; CHECK-NEXT: call void @__asan_storeN(i64 %p{{[0-9]*}}, i64 [[SIZE32]]), !dbg [[STORE32:![0-9]+]]
+; CHECK-NEXT: br label %loop
+
+; CHECK-LABEL: define void @store_i64(
+; CHECK: loop.preheader:
+; CHECK: [[SIZE64:%[0-9]+]] = add i64 %{{[0-9]+}}, 8
+; CHECK-NEXT: call void @__asan_storeN(i64 %p{{[0-9]*}}, i64 [[SIZE64]]), !dbg [[STORE64:![0-9]+]]
+; CHECK-NEXT: br label %loop
+
+; CHECK-LABEL: define void @conditional_store(
+; CHECK-NOT: call void @__asan_storeN
+; CHECK-LABEL: define internal void @asan.module_ctor()
+
+; CHECK: [[STORE32]] = !DILocation(line: 2,
+; CHECK: [[STORE64]] = !DILocation(line: 5,
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @store_i32(i32* %p, i64 %n) sanitize_address {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %addr = getelementptr inbounds i32, i32* %p, i64 %i
+  store i32 0, i32* %addr, align 4, !dbg !9
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @store_i64(i64* %p, i64 %n) sanitize_address {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %addr = getelementptr inbounds i64, i64* %p, i64 %i
+  store i64 0, i64* %addr, align 8, !dbg !10
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; The store only happens in some iterations.
+define void @conditional_store(i32* %p, i64 %n, i1 %c) sanitize_address {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  br i1 %c, label %then, label %latch
+
+then:
+  %addr = getelementptr inbounds i32, i32* %p, i64 %i
+  store i32 0, i32* %addr, align 4, !dbg !11
+  br label %latch
+
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "hoist.c", directory: "/tmp")
+!2 = !{!3, !4, !5}
+!3 = !DISubprogram(name: "store_i32", scope: !1, file: !1, line: 1, type: !6, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: false, function: void (i32*, i64)* @store_i32, variables: !8)
+!4 = !DISubprogram(name: "store_i64", scope: !1, file: !1, line: 4, type: !6, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: false, function: void (i64*, i64)* @store_i64, variables: !8)
+!5 = !DISubprogram(name: "conditional_store", scope: !1, file: !1, line: 7, type: !6, isLocal: false, isDefinition: true, scopeLine: 7, isOptimized: false, function: void (i32*, i64, i1)* @conditional_store, variables: !8)
+!6 = !DISubroutineType(types: !8)
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!8 = !{}
+!9 = !DILocation(line: 2, column: 3, scope: !3)
+!10 = !DILocation(line: 5, column: 3, scope: !4)
+!11 = !DILocation(line: 8, column: 3, scope: !5)
@@ -0,0 +1,74 @@
+; Test that the checks of internal functions keep their IDs when linking
+; renames them, and that same-named internal functions of different modules
+; have different IDs.
+; RUN: rm -rf %t && mkdir -p %t/costs
+; RUN: echo '# asap-line-profile' > %t/a.prof
+; RUN: echo '1 h.h:2' >> %t/a.prof
+; RUN: echo '# asap-line-profile' > %t/b.prof
+; RUN: echo '100 h.h:2' >> %t/b.prof
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -sanity-check-cost \
+; RUN:   -asap-profile=%t/a.prof -asap-cost-file=%t/costs/a.costs.bin \
+; RUN:   -disable-output %s
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -sanity-check-cost \
+; RUN:   -asap-profile=%t/b.prof -asap-cost-file=%t/costs/b.costs.bin \
+; RUN:   -disable-output %S/Inputs/internal-ids-b.ll
+; RUN: llvm-link %s %S/Inputs/internal-ids-b.ll -o %t/linked.bc
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap \
+; RUN:   -asap-cost-threshold=50 -asap-load-costs=%t/costs %t/linked.bc -S \
+; RUN:   -o %t/linked.ll 2>&1 | FileCheck %s -check-prefix=STATS
+; RUN: FileCheck %s < %t/linked.ll
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap \
+; RUN:   -asap-cost-threshold=50 -asap-load-costs=%t/costs/a.costs.bin \
+; RUN:   %t/linked.bc -disable-output 2>&1 | FileCheck %s -check-prefix=MISSING
+; REQUIRES: loadable_module
+
+; STATS-NOT: Warning
+; STATS: Removed 1 out of 2 static checks
+; STATS-NEXT: Removed 100 out of 101 dynamic checks
+
+; The cold copy of foo is this module's, the hot one comes from b.c.
+; CHECK-LABEL: define internal i32 @foo(i32 %x)
+; CHECK: br i1 %c, label %ok, label %fail
+; CHECK-LABEL: define internal i32 @foo.1(i32 %x)
+; CHECK: br i1 true, label %ok, label %fail
+
+; MISSING: Warning: 1 out of 2 sanity checks not found in the cost files
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @a(i32 %x) {
+entry:
+  %r = call i32 @foo(i32 %x)
+  ret i32 %r
+}
+
+define internal i32 @foo(i32 %x) {
+entry:
+  %c = icmp slt i32 %x, 10, !dbg !9
+  br i1 %c, label %ok, label %fail, !dbg !9
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null), !dbg !9
+  unreachable
+
+ok:
+  ret i32 %x, !dbg !10
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "a.c", directory: "/tmp")
+!2 = !{!3}
+!3 = !DISubprogram(name: "foo", scope: !8, file: !8, line: 1, type: !4, isLocal: true, isDefinition: true, scopeLine: 1, isOptimized: false, function: i32 (i32)* @foo, variables: !6)
+!4 = !DISubroutineType(types: !5)
+!5 = !{null}
+!6 = !{}
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!8 = !DIFile(filename: "h.h", directory: "/tmp")
+!9 = !DILocation(line: 2, column: 3, scope: !3)
+!10 = !DILocation(line: 3, column: 3, scope: !3)
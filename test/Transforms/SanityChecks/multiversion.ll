@@ -0,0 +1,99 @@
+; Test that -asap-multiversion turns a function into a dispatcher between a
+; checked and an unchecked variant.
+; RUN: echo '# asap-line-profile' > %t.prof
+; RUN: echo '100 mv.c:5' >> %t.prof
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -sanity-level=1 \
+; RUN:   -asap-profile=%t.prof -asap-multiversion=1 -asap-sampling-period=10 \
+; RUN:   -asap-report=%t.yaml -S %s -o %t.ll 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=STATS
+; RUN: FileCheck %s < %t.ll
+; RUN: FileCheck %s -check-prefix=REPORT < %t.yaml
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -sanity-level=0 \
+; RUN:   -asap-profile=%t.prof -asap-report=%t.removed.yaml -disable-output %s
+; RUN: FileCheck %s -check-prefix=REMOVED < %t.removed.yaml
+; RUN: opt -inline -disable-output %t.ll
+; RUN: not opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -sanity-level=1 \
+; RUN:   -asap-profile=%t.prof -asap-multiversion=1 -asap-sampling-period=0 \
+; RUN:   -disable-output %s 2>&1 | FileCheck %s -check-prefix=ZERO
+; REQUIRES: loadable_module
+
+; STATS: Multiversioned 1 functions; 1 more checks only run in their checked variants
+; ZERO: -asap-sampling-period must be positive
+
+; The check of a multiversioned function is sampled, not removed.
+; REPORT: total-checks: 1
+; REPORT-NEXT: removed-checks: 0
+; REPORT-NEXT: total-cost: 100
+; REPORT-NEXT: removed-cost: 0
+; REPORT: kind: assert
+; REPORT-NEXT: function: foo
+; REPORT-NEXT: location: 'mv.c:5:3'
+; REPORT-NEXT: cost: 100
+; REPORT-NEXT: decision: sampled
+
+; REMOVED: removed-checks: 1
+; REMOVED: removed-cost: 100
+; REMOVED: decision: removed
+
+; CHECK: @asap.sampling_period = internal global i32 10
+; CHECK: @llvm.global_ctors = {{.*}} @asap.init_sampling_period
+
+; The dispatcher calls the checked variant once every ten calls. The calls have
+; the location of foo itself, so that the variants can be inlined.
+; CHECK-LABEL: define i32 @foo(i32 %x)
+; CHECK: load atomic i32, i32* @foo.asap.counter monotonic
+; CHECK: load i32, i32* @asap.sampling_period
+; CHECK: br i1 %{{.*}}, label %checked, label %unchecked, !dbg [[DISPATCH:![0-9]+]], !prof [[WEIGHTS:![0-9]+]]
+; CHECK: checked:
+; CHECK-NEXT: tail call i32 @foo.asap.checked(i32 %x), !dbg [[DISPATCH]]
+; CHECK: unchecked:
+; CHECK-NEXT: tail call i32 @foo.asap.unchecked(i32 %x), !dbg [[DISPATCH]]
+
+; CHECK-LABEL: define internal i32 @foo.asap.checked(i32 %x)
+; CHECK: br i1 %c, label %ok, label %fail
+; CHECK: call void @__assert_fail
+
+; CHECK-LABEL: define internal i32 @foo.asap.unchecked(i32 %x)
+; CHECK: br i1 true, label %ok, label %fail
+
+; Only positive values of ASAP_SAMPLING_PERIOD replace the default period.
+; CHECK-LABEL: define internal void @asap.init_sampling_period()
+; CHECK: call i32 @atoi
+; CHECK: icmp sgt i32 %{{.*}}, 0
+; CHECK: store i32 %{{.*}}, i32* @asap.sampling_period
+
+; CHECK-DAG: [[DISPATCH]] = !DILocation(line: 4, scope: [[FOO:![0-9]+]])
+; CHECK-DAG: [[FOO]] = !DISubprogram(name: "foo", {{.*}}function: i32 (i32)* @foo,
+; CHECK-DAG: [[WEIGHTS]] = !{!"branch_weights", i32 1, i32 9}
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @foo(i32 %x) {
+entry:
+  %c = icmp slt i32 %x, 10, !dbg !9
+  br i1 %c, label %ok, label %fail, !dbg !9
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null), !dbg !9
+  unreachable
+
+ok:
+  ret i32 %x, !dbg !10
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "mv.c", directory: "/tmp")
+!2 = !{!3}
+!3 = !DISubprogram(name: "foo", scope: !1, file: !1, line: 3, type: !4, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: false, function: i32 (i32)* @foo, variables: !6)
+!4 = !DISubroutineType(types: !5)
+!5 = !{null}
+!6 = !{}
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!9 = !DILocation(line: 5, column: 3, scope: !3)
+!10 = !DILocation(line: 6, column: 3, scope: !3)
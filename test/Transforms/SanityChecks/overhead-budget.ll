@@ -0,0 +1,84 @@
+; Test that -asap-overhead-budget removes checks until the remaining ones cost
+; at most the given percentage of the baseline.
+; RUN: echo '# asap-line-profile' > %t.prof
+; RUN: echo '40 th.c:5' >> %t.prof
+; RUN: echo '30 th.c:6' >> %t.prof
+; RUN: echo '20 th.c:7' >> %t.prof
+; RUN: echo '10 th.c:8' >> %t.prof
+; RUN: echo '100 th.c:9' >> %t.prof
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap \
+; RUN:   -asap-overhead-budget=25 -asap-profile=%t.prof -disable-output %s 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=BUDGET25
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap \
+; RUN:   -asap-overhead-budget=35 -asap-greedy -asap-profile=%t.prof \
+; RUN:   -disable-output %s 2>&1 | FileCheck %s -check-prefix=GREEDY35
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap \
+; RUN:   -asap-overhead-budget=100 -asap-profile=%t.prof -disable-output %s \
+; RUN:   2>&1 | FileCheck %s -check-prefix=BUDGET100
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap \
+; RUN:   -asap-overhead-budget=0 -asap-profile=%t.prof -disable-output %s 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=BUDGET0
+; REQUIRES: loadable_module
+
+; The checks cost 40, 30, 20 and 10, and the mul costs 100.
+
+; BUDGET25: Removed 3 out of 4 static checks
+; BUDGET25-NEXT: Removed 90 out of 100 dynamic checks
+; BUDGET25-NEXT: Remaining checks cost 10.00% of the baseline (budget 25.00%)
+
+; GREEDY35: Removed 2 out of 4 static checks
+; GREEDY35-NEXT: Removed 70 out of 100 dynamic checks
+; GREEDY35-NEXT: Remaining checks cost 30.00% of the baseline (budget 35.00%)
+
+; BUDGET100: Removed 0 out of 4 static checks
+; BUDGET100-NEXT: Removed 0 out of 100 dynamic checks
+
+; BUDGET0: Removed 4 out of 4 static checks
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @f(i32 %x) {
+entry:
+  %c1 = icmp ult i32 %x, 100, !dbg !9
+  br i1 %c1, label %check2, label %fail, !dbg !9
+
+check2:
+  %c2 = icmp ult i32 %x, 200, !dbg !10
+  br i1 %c2, label %check3, label %fail, !dbg !10
+
+check3:
+  %c3 = icmp ult i32 %x, 300, !dbg !11
+  br i1 %c3, label %check4, label %fail, !dbg !11
+
+check4:
+  %c4 = icmp ult i32 %x, 400, !dbg !12
+  br i1 %c4, label %ok, label %fail, !dbg !12
+
+ok:
+  %r = mul i32 %x, %x, !dbg !13
+  ret i32 %r, !dbg !13
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null), !dbg !13
+  unreachable
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "th.c", directory: "/tmp")
+!2 = !{!3}
+!3 = !DISubprogram(name: "f", scope: !1, file: !1, line: 3, type: !4, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: false, function: i32 (i32)* @f, variables: !6)
+!4 = !DISubroutineType(types: !5)
+!5 = !{null}
+!6 = !{}
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!9 = !DILocation(line: 5, column: 3, scope: !3)
+!10 = !DILocation(line: 6, column: 3, scope: !3)
+!11 = !DILocation(line: 7, column: 3, scope: !3)
+!12 = !DILocation(line: 8, column: 3, scope: !3)
+!13 = !DILocation(line: 9, column: 3, scope: !3)
@@ -0,0 +1,96 @@
+; Test that -asap-greedy and -asap-split-shared-costs account for the udiv that
+; the checks at lines 5 and 6 share.
+; RUN: echo '# asap-line-profile' > %t.prof
+; RUN: echo '10 shared.c:5' >> %t.prof
+; RUN: echo '12 shared.c:6' >> %t.prof
+; RUN: echo '8 shared.c:7' >> %t.prof
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -cost-level=0.6 \
+; RUN:   -asap-profile=%t.prof -print-removed-checks -disable-output %s 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=ORDER60
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -cost-level=0.6 \
+; RUN:   -asap-greedy -asap-profile=%t.prof -print-removed-checks \
+; RUN:   -disable-output %s 2>&1 | FileCheck %s -check-prefix=GREEDY60
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -cost-level=0 \
+; RUN:   -asap-greedy -asap-profile=%t.prof -disable-output %s 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=GREEDY0
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -cost-level=0.25 \
+; RUN:   -asap-profile=%t.prof -print-removed-checks -disable-output %s 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=ORDER25
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap -cost-level=0.25 \
+; RUN:   -asap-split-shared-costs -asap-profile=%t.prof -print-removed-checks \
+; RUN:   -disable-output %s 2>&1 | FileCheck %s -check-prefix=SPLIT25
+; REQUIRES: loadable_module
+
+; Each check costs its icmp, plus the udiv: 20 (line 5), 22 (line 6) and 16
+; (line 7), i.e., 58 in total. Counted once, the udiv makes the total 48.
+
+; By cost, the check at line 6 is removed first, and fills the budget.
+; ORDER60: shared.c:6:3: SanityCheck with cost i64 22
+; ORDER60-NEXT: Removed 1 out of 3 static checks
+; ORDER60-NEXT: Removed 22 out of 58 dynamic checks
+
+; Removing the check at line 6 only saves its icmp (12), while the one at
+; line 7 saves 16.
+; GREEDY60: shared.c:7:3: SanityCheck with cost i64 16
+; GREEDY60-NEXT: Removed 1 out of 3 static checks
+; GREEDY60-NEXT: Removed 16 out of 48 dynamic checks
+
+; The udiv is saved once, when the second of its checks is removed.
+; GREEDY0: Removed 3 out of 3 static checks
+; GREEDY0-NEXT: Removed 48 out of 48 dynamic checks
+
+; ORDER25: shared.c:6:3: SanityCheck with cost i64 22
+; ORDER25-NEXT: shared.c:5:3: SanityCheck with cost i64 20
+; ORDER25-NEXT: Removed 2 out of 3 static checks
+; ORDER25-NEXT: Removed 42 out of 58 dynamic checks
+
+; Split evenly, the checks at lines 5 and 6 cost 15 and 17, so the check at
+; line 7 comes before the one at line 5.
+; SPLIT25: shared.c:6:3: SanityCheck with cost i64 17
+; SPLIT25-NEXT: shared.c:7:3: SanityCheck with cost i64 16
+; SPLIT25-NEXT: Removed 2 out of 3 static checks
+; SPLIT25-NEXT: Removed 33 out of 48 dynamic checks
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @f(i32 %x, i32 %y) {
+entry:
+  %s = udiv i32 %x, %y, !dbg !9
+  %a = icmp ult i32 %s, 100, !dbg !9
+  br i1 %a, label %check.b, label %fail, !dbg !9
+
+check.b:
+  %b = icmp ugt i32 %s, 10, !dbg !10
+  br i1 %b, label %check.c, label %fail, !dbg !10
+
+check.c:
+  %t = udiv i32 %y, %x, !dbg !11
+  %c = icmp ult i32 %t, 100, !dbg !11
+  br i1 %c, label %ok, label %fail, !dbg !11
+
+ok:
+  ret i32 %x, !dbg !12
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null), !dbg !12
+  unreachable
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "shared.c", directory: "/tmp")
+!2 = !{!3}
+!3 = !DISubprogram(name: "f", scope: !1, file: !1, line: 3, type: !4, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: false, function: i32 (i32, i32)* @f, variables: !6)
+!4 = !DISubroutineType(types: !5)
+!5 = !{null}
+!6 = !{}
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!9 = !DILocation(line: 5, column: 3, scope: !3)
+!10 = !DILocation(line: 6, column: 3, scope: !3)
+!11 = !DILocation(line: 7, column: 3, scope: !3)
+!12 = !DILocation(line: 8, column: 3, scope: !3)
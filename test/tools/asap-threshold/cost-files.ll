@@ -0,0 +1,108 @@
+; Test that asap-threshold merges the cost files written by -asap-cost-file,
+; and that the ASAP pass removes the checks it counts.
+; RUN: rm -rf %t && mkdir -p %t/costs
+; RUN: echo '# asap-line-profile' > %t/a.prof
+; RUN: echo '40 th.c:5' >> %t/a.prof
+; RUN: echo '30 th.c:6' >> %t/a.prof
+; RUN: echo '20 th.c:7' >> %t/a.prof
+; RUN: echo '10 th.c:8' >> %t/a.prof
+; RUN: echo '100 th.c:9' >> %t/a.prof
+; RUN: echo '# asap-line-profile' > %t/b.prof
+; RUN: echo '35 th.c:5' >> %t/b.prof
+; RUN: echo '5 th.c:6' >> %t/b.prof
+; RUN: echo '100 th.c:9' >> %t/b.prof
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -sanity-check-cost \
+; RUN:   -asap-profile=%t/a.prof -asap-cost-file=%t/costs/a.costs.bin \
+; RUN:   -disable-output %s
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -sanity-check-cost \
+; RUN:   -asap-profile=%t/b.prof -asap-cost-file=%t/costs/b.costs.bin \
+; RUN:   -disable-output %s
+; RUN: asap-threshold -cost-level=0.5 %t/costs | FileCheck %s -check-prefix=COST
+; RUN: asap-threshold -sanity-level=0.5 %t/costs \
+; RUN:   | FileCheck %s -check-prefix=SANITY
+; RUN: asap-threshold -asap-overhead-budget=10 %t/costs/a.costs.bin \
+; RUN:   %t/costs/b.costs.bin | FileCheck %s -check-prefix=BUDGET
+; RUN: asap-threshold -cost-level=0.5 %t/costs/a.costs.bin \
+; RUN:   | FileCheck %s -check-prefix=SINGLE
+; RUN: opt -load=%llvmshlibdir/SanityChecks%shlibext -asap \
+; RUN:   -asap-cost-threshold=40 -asap-load-costs=%t/costs/a.costs.bin \
+; RUN:   -disable-output %s 2>&1 | FileCheck %s -check-prefix=LOAD
+; RUN: not asap-threshold -cost-level=0.5 %s 2>&1 \
+; RUN:   | FileCheck %s -check-prefix=INVALID
+; REQUIRES: loadable_module
+
+; The two files hold the costs 40, 30, 20, 10 and 35, 5, 0, 0, and a baseline
+; cost of 100 each.
+
+; Removing checks costing 35 or more would leave less than half of the cost.
+; COST: Cost threshold is 40
+; COST-NEXT: Removing 1 out of 8 static checks (12.50%)
+; COST-NEXT: Removing 40 out of 140 dynamic checks (28.57%)
+; COST-NEXT: Remaining checks cost 50.00% of the baseline
+
+; SANITY: Cost threshold is 20
+; SANITY-NEXT: Removing 4 out of 8 static checks (50.00%)
+
+; 10% of the baseline leaves 20 for the checks.
+; BUDGET: Cost threshold is 20
+; BUDGET-NEXT: Removing 4 out of 8 static checks (50.00%)
+; BUDGET-NEXT: Removing 125 out of 140 dynamic checks (89.29%)
+; BUDGET-NEXT: Remaining checks cost 7.50% of the baseline
+
+; SINGLE: Cost threshold is 40
+; SINGLE-NEXT: Removing 1 out of 4 static checks (25.00%)
+; SINGLE-NEXT: Removing 40 out of 100 dynamic checks (40.00%)
+
+; The pass finds the checks of the cost file by their IDs.
+; LOAD: Removed 1 out of 4 static checks
+; LOAD-NEXT: Removed 40 out of 100 dynamic checks
+
+; INVALID: error: {{.*}}cost-files.ll: Invalid argument
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @f(i32 %x) {
+entry:
+  %c1 = icmp ult i32 %x, 100, !dbg !9
+  br i1 %c1, label %check2, label %fail, !dbg !9
+
+check2:
+  %c2 = icmp ult i32 %x, 200, !dbg !10
+  br i1 %c2, label %check3, label %fail, !dbg !10
+
+check3:
+  %c3 = icmp ult i32 %x, 300, !dbg !11
+  br i1 %c3, label %check4, label %fail, !dbg !11
+
+check4:
+  %c4 = icmp ult i32 %x, 400, !dbg !12
+  br i1 %c4, label %ok, label %fail, !dbg !12
+
+ok:
+  %r = mul i32 %x, %x, !dbg !13
+  ret i32 %r, !dbg !13
+
+fail:
+  call void @__assert_fail(i8* null, i8* null, i32 0, i8* null), !dbg !13
+  unreachable
+}
+
+declare void @__assert_fail(i8*, i8*, i32, i8*)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!7}
+
+!0 = !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: false, runtimeVersion: 0, emissionKind: 1, subprograms: !2)
+!1 = !DIFile(filename: "th.c", directory: "/tmp")
+!2 = !{!3}
+!3 = !DISubprogram(name: "f", scope: !1, file: !1, line: 3, type: !4, isLocal: false, isDefinition: true, scopeLine: 4, isOptimized: false, function: i32 (i32)* @f, variables: !6)
+!4 = !DISubroutineType(types: !5)
+!5 = !{null}
+!6 = !{}
+!7 = !{i32 2, !"Debug Info Version", i32 3}
+!9 = !DILocation(line: 5, column: 3, scope: !3)
+!10 = !DILocation(line: 6, column: 3, scope: !3)
+!11 = !DILocation(line: 7, column: 3, scope: !3)
+!12 = !DILocation(line: 8, column: 3, scope: !3)
+!13 = !DILocation(line: 9, column: 3, scope: !3)
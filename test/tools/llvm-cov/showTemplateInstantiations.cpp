@@ -38,3 +38,7 @@ int main() {         // ALL:         1| [[@LINE]]|int main() {
 }                    // ALL-NEXT:    1| [[@LINE]]|}
 // after coverage    // ALL-NEXT:     | [[@LINE]]|// after
                      // FILTER-NOT:   | [[@LINE-1]]|// after
+
+// Rendering on several threads prints the files in order, with the same
+// contents. This RUN line is last, so that it doesn't shift the lines above.
+// RUN: llvm-cov show %S/Inputs/templateInstantiations.covmapping -instr-profile %S/Inputs/templateInstantiations.profdata -filename-equivalence -j 2 %s %s | FileCheck -check-prefix=CHECK -check-prefix=ALL %s
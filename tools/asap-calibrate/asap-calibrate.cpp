@@ -0,0 +1,445 @@
+//===- asap-calibrate.cpp - Measure the costs of sanity checks ------------===//
+//
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+//===----------------------------------------------------------------------===//
+//
+// asap-calibrate measures how many cycles each kind of sanity check takes on
+// the host CPU, and writes a calibration table that can be passed to
+// `opt -sanity-check-cost -asap-calibration=...` (see CostCalibration.h).
+//
+// For every kind of check, two microkernels are JIT-compiled: a loop that
+// performs a memory access or arithmetic operation, and the same loop with the
+// check added. The checks are built like the sanitizers build them, and never
+// fail. The kernels run under a perf_event cycle counter; the difference per
+// iteration is the cost of the check. Accesses walk through a working set of
+// configurable size, so that shadow memory loads can miss the cache like they
+// do in real programs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+static cl::opt<std::string>
+    OutputFilename("o", cl::desc("Output calibration table (default: stdout)"),
+                   cl::value_desc("filename"), cl::init("-"));
+
+static cl::opt<unsigned>
+    Iterations("iterations", cl::desc("Iterations of each kernel"),
+               cl::init(10000000));
+
+static cl::opt<unsigned>
+    Repetitions("repetitions",
+                cl::desc("Runs of each kernel; the fastest run counts"),
+                cl::init(5));
+
+static cl::opt<unsigned>
+    WorkingSet("working-set",
+               cl::desc("Bytes of memory accessed by the kernels (rounded up "
+                        "to a power of two)"),
+               cl::init(1 << 20));
+
+// Accesses are spread over cache lines.
+static const unsigned AccessStride = 64;
+static const unsigned ShadowScale = 3;
+
+static void exitWithError(const Twine &Message) {
+  errs() << "error: " << Message << "\n";
+  ::exit(1);
+}
+
+static void reportUnexpectedCheckFailure() {
+  errs() << "error: a calibration check failed\n";
+  ::abort();
+}
+
+namespace {
+/// A kind of sanity check, named after the function it calls on failure.
+struct CheckShape {
+  enum ShapeKind { ASan, ASanSlowPath, Overflow, Assert };
+
+  std::string Name;
+  ShapeKind Kind;
+  bool IsWrite;
+  unsigned Size;     // Access size in bytes, for ASan checks
+  Intrinsic::ID Op;  // Operation, for overflow checks
+};
+
+/// Builds the kernels for a check shape. Each kernel has the signature
+/// void(i8 *Mem, i64 N), and runs N iterations.
+class KernelBuilder {
+public:
+  KernelBuilder(Module &M, uint64_t ShadowOffset)
+      : M(M), Ctx(M.getContext()), ShadowOffset(ShadowOffset),
+        Int8PtrTy(Type::getInt8PtrTy(Ctx)), Int32Ty(Type::getInt32Ty(Ctx)),
+        Int64Ty(Type::getInt64Ty(Ctx)) {}
+
+  Function *build(const CheckShape &S, bool WithCheck, StringRef Name);
+
+private:
+  Module &M;
+  LLVMContext &Ctx;
+  uint64_t ShadowOffset;
+  Type *Int8PtrTy;
+  IntegerType *Int32Ty;
+  IntegerType *Int64Ty;
+
+  void emitBody(IRBuilder<> &IRB, const CheckShape &S, bool WithCheck,
+                Value *Addr, Value *I, Value *Sink);
+  void emitASanCheck(IRBuilder<> &IRB, const CheckShape &S, Value *Addr);
+  BasicBlock *createFailureBlock(Function *F, StringRef Callee,
+                                 ArrayRef<Value *> Args);
+};
+} // end anonymous namespace
+
+Function *KernelBuilder::build(const CheckShape &S, bool WithCheck,
+                               StringRef Name) {
+  FunctionType *FTy = FunctionType::get(Type::getVoidTy(Ctx),
+                                        {Int8PtrTy, Int64Ty}, false);
+  Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage, Name, &M);
+  Function::arg_iterator AI = F->arg_begin();
+  Value *Mem = &*AI++;
+  Value *N = &*AI;
+
+  BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", F);
+  BasicBlock *Loop = BasicBlock::Create(Ctx, "loop", F);
+  BasicBlock *Exit = BasicBlock::Create(Ctx, "exit", F);
+
+  IRBuilder<> IRB(Entry);
+  Value *Sink = IRB.CreateAlloca(Int32Ty, nullptr, "sink");
+  IRB.CreateBr(Loop);
+
+  IRB.SetInsertPoint(Loop);
+  PHINode *I = IRB.CreatePHI(Int64Ty, 2, "i");
+  I->addIncoming(ConstantInt::get(Int64Ty, 0), Entry);
+  Value *Offset =
+      IRB.CreateAnd(IRB.CreateMul(I, ConstantInt::get(Int64Ty, AccessStride)),
+                    ConstantInt::get(Int64Ty, WorkingSet - 1));
+  Value *Addr = IRB.CreateGEP(Mem, Offset);
+  emitBody(IRB, S, WithCheck, Addr, I, Sink);
+
+  Value *Next = IRB.CreateAdd(I, ConstantInt::get(Int64Ty, 1));
+  I->addIncoming(Next, IRB.GetInsertBlock());
+  IRB.CreateCondBr(IRB.CreateICmpULT(Next, N), Loop, Exit);
+
+  IRB.SetInsertPoint(Exit);
+  IRB.CreateRetVoid();
+  return F;
+}
+
+void KernelBuilder::emitBody(IRBuilder<> &IRB, const CheckShape &S,
+                             bool WithCheck, Value *Addr, Value *I,
+                             Value *Sink) {
+  switch (S.Kind) {
+  case CheckShape::ASan:
+  case CheckShape::ASanSlowPath: {
+    if (WithCheck)
+      emitASanCheck(IRB, S, Addr);
+    Type *AccessTy = IntegerType::get(Ctx, S.Size * 8);
+    Value *Ptr = IRB.CreateBitCast(Addr, AccessTy->getPointerTo());
+    if (S.IsWrite)
+      IRB.CreateStore(IRB.CreateZExtOrTrunc(I, AccessTy), Ptr, true);
+    else
+      IRB.CreateLoad(Ptr, true);
+    return;
+  }
+
+  case CheckShape::Overflow: {
+    // Memory is zeroed before each run, and the result goes to a sink rather
+    // than back to memory, so 0 op Y, with Y < 2^16, never overflows.
+    Value *Ptr = IRB.CreateBitCast(Addr, Int32Ty->getPointerTo());
+    Value *X = IRB.CreateLoad(Ptr, true);
+    Value *Y = IRB.CreateAnd(IRB.CreateTrunc(I, Int32Ty),
+                             ConstantInt::get(Int32Ty, 0xffff));
+    Value *Result;
+    if (WithCheck) {
+      Value *Call = IRB.CreateCall(
+          Intrinsic::getDeclaration(&M, S.Op, Int32Ty), {X, Y});
+      Result = IRB.CreateExtractValue(Call, 0);
+      Value *Overflow = IRB.CreateExtractValue(Call, 1);
+      BasicBlock *Cont =
+          BasicBlock::Create(Ctx, "cont", IRB.GetInsertBlock()->getParent());
+      BasicBlock *Fail = createFailureBlock(
+          Cont->getParent(), S.Name,
+          {ConstantPointerNull::get(cast<PointerType>(Int8PtrTy)),
+           IRB.CreateZExt(X, Int64Ty), IRB.CreateZExt(Y, Int64Ty)});
+      IRB.CreateCondBr(Overflow, Fail, Cont,
+                       MDBuilder(Ctx).createBranchWeights(1, 1 << 20));
+      IRB.SetInsertPoint(Cont);
+    } else if (S.Op == Intrinsic::sadd_with_overflow) {
+      Result = IRB.CreateAdd(X, Y);
+    } else if (S.Op == Intrinsic::ssub_with_overflow) {
+      Result = IRB.CreateSub(X, Y);
+    } else {
+      Result = IRB.CreateMul(X, Y);
+    }
+    IRB.CreateStore(Result, Sink, true);
+    return;
+  }
+
+  case CheckShape::Assert: {
+    // Memory is zeroed before each run, so the assertion holds.
+    Value *Ptr = IRB.CreateBitCast(Addr, Int32Ty->getPointerTo());
+    Value *X = IRB.CreateLoad(Ptr, true);
+    if (WithCheck) {
+      BasicBlock *Cont =
+          BasicBlock::Create(Ctx, "cont", IRB.GetInsertBlock()->getParent());
+      Value *Null = ConstantPointerNull::get(cast<PointerType>(Int8PtrTy));
+      BasicBlock *Fail =
+          createFailureBlock(Cont->getParent(), S.Name,
+                             {Null, Null, ConstantInt::get(Int32Ty, 0), Null});
+      IRB.CreateCondBr(IRB.CreateIsNotNull(X), Fail, Cont);
+      IRB.SetInsertPoint(Cont);
+    }
+    return;
+  }
+  }
+}
+
+// Emits the same instructions as AddressSanitizer::instrumentAddress, except
+// that the shadow offset points into the tool's own shadow buffer.
+void KernelBuilder::emitASanCheck(IRBuilder<> &IRB, const CheckShape &S,
+                                  Value *Addr) {
+  Function *F = IRB.GetInsertBlock()->getParent();
+  Value *AddrLong = IRB.CreatePtrToInt(Addr, Int64Ty);
+  IntegerType *ShadowTy =
+      IntegerType::get(Ctx, std::max(8U, S.Size * 8 >> ShadowScale));
+  Value *ShadowPtr = IRB.CreateIntToPtr(
+      IRB.CreateAdd(IRB.CreateLShr(AddrLong, ShadowScale),
+                    ConstantInt::get(Int64Ty, ShadowOffset)),
+      ShadowTy->getPointerTo());
+  Value *ShadowValue = IRB.CreateLoad(ShadowPtr);
+  Value *Cmp = IRB.CreateICmpNE(ShadowValue, ConstantInt::get(ShadowTy, 0));
+
+  BasicBlock *Cont = BasicBlock::Create(Ctx, "cont", F);
+  BasicBlock *Fail = createFailureBlock(F, S.Name, {AddrLong});
+  MDNode *Weights = MDBuilder(Ctx).createBranchWeights(1, 100000);
+  if (S.Size >= 1U << ShadowScale) {
+    IRB.CreateCondBr(Cmp, Fail, Cont, Weights);
+  } else {
+    BasicBlock *Slow = BasicBlock::Create(Ctx, "slow", F, Fail);
+    IRB.CreateCondBr(Cmp, Slow, Cont, Weights);
+    IRB.SetInsertPoint(Slow);
+    Value *LastAccessedByte = IRB.CreateAnd(
+        AddrLong, ConstantInt::get(Int64Ty, (1U << ShadowScale) - 1));
+    if (S.Size > 1)
+      LastAccessedByte = IRB.CreateAdd(LastAccessedByte,
+                                       ConstantInt::get(Int64Ty, S.Size - 1));
+    LastAccessedByte = IRB.CreateIntCast(LastAccessedByte, ShadowTy, false);
+    IRB.CreateCondBr(IRB.CreateICmpSGE(LastAccessedByte, ShadowValue), Fail,
+                     Cont);
+  }
+  IRB.SetInsertPoint(Cont);
+}
+
+BasicBlock *KernelBuilder::createFailureBlock(Function *F, StringRef Callee,
+                                              ArrayRef<Value *> Args) {
+  std::vector<Type *> ArgTys;
+  for (Value *A : Args)
+    ArgTys.push_back(A->getType());
+  Constant *Handler = M.getOrInsertFunction(
+      Callee, FunctionType::get(Type::getVoidTy(Ctx), ArgTys, false));
+  sys::DynamicLibrary::AddSymbol(
+      Callee, reinterpret_cast<void *>(&reportUnexpectedCheckFailure));
+
+  BasicBlock *Fail = BasicBlock::Create(Ctx, "fail", F);
+  IRBuilder<> IRB(Fail);
+  IRB.CreateCall(Handler, Args);
+  IRB.CreateUnreachable();
+  return Fail;
+}
+
+static std::vector<CheckShape> getCheckShapes() {
+  std::vector<CheckShape> Shapes;
+  for (bool IsWrite : {false, true}) {
+    for (unsigned Size : {1, 2, 4, 8, 16}) {
+      std::string Name = std::string("__asan_report_") +
+                         (IsWrite ? "store" : "load") + utostr(Size);
+      Shapes.push_back({Name, CheckShape::ASan, IsWrite, Size,
+                        Intrinsic::not_intrinsic});
+      if (Size < 1U << ShadowScale)
+        Shapes.push_back({Name + ":slow", CheckShape::ASanSlowPath, IsWrite,
+                          Size, Intrinsic::not_intrinsic});
+    }
+  }
+  Shapes.push_back({"__ubsan_handle_add_overflow_abort", CheckShape::Overflow,
+                    false, 0, Intrinsic::sadd_with_overflow});
+  Shapes.push_back({"__ubsan_handle_sub_overflow_abort", CheckShape::Overflow,
+                    false, 0, Intrinsic::ssub_with_overflow});
+  Shapes.push_back({"__ubsan_handle_mul_overflow_abort", CheckShape::Overflow,
+                    false, 0, Intrinsic::smul_with_overflow});
+  Shapes.push_back({"__assert_fail", CheckShape::Assert, false, 0,
+                    Intrinsic::not_intrinsic});
+  return Shapes;
+}
+
+typedef void (*KernelFn)(uint8_t *, uint64_t);
+
+#ifdef __linux__
+static int openCycleCounter() {
+  struct perf_event_attr Attr;
+  memset(&Attr, 0, sizeof(Attr));
+  Attr.size = sizeof(Attr);
+  Attr.type = PERF_TYPE_HARDWARE;
+  Attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  Attr.disabled = 1;
+  Attr.exclude_kernel = 1;
+  Attr.exclude_hv = 1;
+  int FD = syscall(__NR_perf_event_open, &Attr, 0, -1, -1, 0);
+  if (FD < 0)
+    exitWithError(Twine("cannot open the cycle counter: ") + strerror(errno) +
+                  " (see /proc/sys/kernel/perf_event_paranoid)");
+  return FD;
+}
+
+// Returns the fewest cycles that any of the runs of Kernel took. Memory is
+// zeroed before every run, since the store kernels write to it and the
+// overflow and assertion kernels rely on it being zero.
+static uint64_t countCycles(int FD, KernelFn Kernel,
+                            std::vector<uint64_t> &Memory) {
+  uint8_t *Mem = reinterpret_cast<uint8_t *>(Memory.data());
+
+  // Warm up caches and page tables.
+  std::fill(Memory.begin(), Memory.end(), 0);
+  Kernel(Mem, Iterations);
+
+  uint64_t Best = UINT64_MAX;
+  for (unsigned R = 0; R != Repetitions; ++R) {
+    std::fill(Memory.begin(), Memory.end(), 0);
+    ioctl(FD, PERF_EVENT_IOC_RESET, 0);
+    ioctl(FD, PERF_EVENT_IOC_ENABLE, 0);
+    Kernel(Mem, Iterations);
+    ioctl(FD, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t Count;
+    if (read(FD, &Count, sizeof(Count)) != sizeof(Count))
+      exitWithError("cannot read the cycle counter");
+    Best = std::min(Best, Count);
+  }
+  return Best;
+}
+#endif
+
+int main(int argc, const char *argv[]) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y; // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "ASAP check cost calibration\n");
+
+#ifndef __linux__
+  exitWithError("asap-calibrate needs perf_event, which requires Linux");
+#else
+  if (Iterations == 0 || Repetitions == 0)
+    exitWithError("-iterations and -repetitions must be positive");
+  WorkingSet = std::max(NextPowerOf2(WorkingSet - 1), (uint64_t)AccessStride);
+
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+
+  // Memory for the kernels, and its shadow. The widest access reaches 16
+  // bytes past the last offset.
+  std::vector<uint64_t> Memory(WorkingSet / sizeof(uint64_t) + 2, 0);
+  uint8_t *Mem = reinterpret_cast<uint8_t *>(Memory.data());
+  std::vector<uint8_t> Shadow((Memory.size() * sizeof(uint64_t) >> ShadowScale) +
+                              1, 0);
+  uint64_t ShadowOffset = reinterpret_cast<uintptr_t>(Shadow.data()) -
+                          (reinterpret_cast<uintptr_t>(Mem) >> ShadowScale);
+
+  LLVMContext Context;
+  std::unique_ptr<Module> Owner(new Module("asap-calibrate", Context));
+  Module *M = Owner.get();
+  KernelBuilder Builder(*M, ShadowOffset);
+  std::vector<CheckShape> Shapes = getCheckShapes();
+  for (unsigned I = 0, E = Shapes.size(); I != E; ++I) {
+    Builder.build(Shapes[I], false, "baseline." + utostr(I));
+    Builder.build(Shapes[I], true, "check." + utostr(I));
+  }
+  if (verifyModule(*M, &errs()))
+    exitWithError("invalid kernel module");
+
+  std::string Error;
+  std::unique_ptr<ExecutionEngine> EE(
+      EngineBuilder(std::move(Owner))
+          .setEngineKind(EngineKind::JIT)
+          .setErrorStr(&Error)
+          .setOptLevel(CodeGenOpt::Aggressive)
+          .setMCPU(sys::getHostCPUName())
+          .create());
+  if (!EE)
+    exitWithError("cannot create the JIT: " + Error);
+  EE->finalizeObject();
+
+  int FD = openCycleCounter();
+  std::vector<double> Costs;
+  for (unsigned I = 0, E = Shapes.size(); I != E; ++I) {
+    // Slow paths are taken when the accessed granule is partially
+    // addressable; a shadow value of 7 makes the first 7 bytes addressable.
+    bool SlowPath = Shapes[I].Kind == CheckShape::ASanSlowPath;
+    std::fill(Shadow.begin(), Shadow.end(), SlowPath ? 7 : 0);
+
+    KernelFn Baseline = reinterpret_cast<KernelFn>(
+        EE->getFunctionAddress("baseline." + utostr(I)));
+    KernelFn Check = reinterpret_cast<KernelFn>(
+        EE->getFunctionAddress("check." + utostr(I)));
+    uint64_t BaselineCycles = countCycles(FD, Baseline, Memory);
+    uint64_t CheckCycles = countCycles(FD, Check, Memory);
+    double Cost = CheckCycles > BaselineCycles
+                      ? (double)(CheckCycles - BaselineCycles) / Iterations
+                      : 0.0;
+    Costs.push_back(Cost);
+  }
+  close(FD);
+
+  std::error_code EC;
+  raw_fd_ostream Out(OutputFilename, EC, sys::fs::F_Text);
+  if (EC)
+    exitWithError(OutputFilename + ": " + EC.message());
+  Out << "# asap-calibrate, " << sys::getHostCPUName() << ", working set "
+      << WorkingSet << " bytes, " << Iterations << " iterations\n";
+  for (unsigned I = 0, E = Shapes.size(); I != E; ++I)
+    Out << Shapes[I].Name << " " << format("%.3f", Costs[I]) << "\n";
+  return 0;
+#endif
+}
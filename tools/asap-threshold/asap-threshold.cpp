@@ -0,0 +1,212 @@
+//===- asap-threshold.cpp - Compute ASAP's cost threshold -----------------===//
+//
+// This file is part of ASAP.
+// Please see LICENSE.txt for copyright and licensing information.
+//
+//===----------------------------------------------------------------------===//
+//
+// asap-threshold reads the binary cost files written by
+// `opt -sanity-check-cost -asap-cost-file=...` and computes the cost threshold
+// for a given sanity level, cost level or overhead budget. Checks costing the
+// threshold or more will be removed by `opt -asap -asap-cost-threshold=...`.
+//
+// Each cost file is sorted by decreasing cost, so the global ranking is
+// obtained with a k-way merge, without reading all costs into memory.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CostFile.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <queue>
+#include <vector>
+
+using namespace llvm;
+using namespace sanitychecks;
+
+static cl::list<std::string>
+    Inputs(cl::Positional, cl::OneOrMore,
+           cl::desc("<cost files or directories to search for *.costs.bin>"));
+
+static cl::opt<double>
+    SanityLevel("sanity-level",
+                cl::desc("Fraction of static checks to be preserved"),
+                cl::init(-1.0));
+
+static cl::opt<double>
+    CostLevel("cost-level",
+              cl::desc("Fraction of dynamic checks to be preserved"),
+              cl::init(-1.0));
+
+static cl::opt<double> OverheadBudget(
+    "asap-overhead-budget",
+    cl::desc("Percentage of the estimated cost of the program without checks "
+             "that the preserved checks may cost"),
+    cl::init(-1.0));
+
+static void exitWithError(const Twine &Message, StringRef Whence = "") {
+  errs() << "error: ";
+  if (!Whence.empty())
+    errs() << Whence << ": ";
+  errs() << Message << "\n";
+  ::exit(1);
+}
+
+static void addCostFile(StringRef Path,
+                        std::vector<std::unique_ptr<costfile::Reader>> &Readers) {
+  auto ReaderOrErr = costfile::Reader::create(Path);
+  if (std::error_code EC = ReaderOrErr.getError())
+    exitWithError(EC.message(), Path);
+  Readers.push_back(std::move(ReaderOrErr.get()));
+}
+
+static void addInput(StringRef Input,
+                     std::vector<std::unique_ptr<costfile::Reader>> &Readers) {
+  if (!sys::fs::is_directory(Input)) {
+    addCostFile(Input, Readers);
+    return;
+  }
+
+  std::error_code EC;
+  for (sys::fs::recursive_directory_iterator I(Input, EC), E; I != E && !EC;
+       I.increment(EC)) {
+    if (StringRef(I->path()).endswith(".costs.bin"))
+      addCostFile(I->path(), Readers);
+  }
+  if (EC)
+    exitWithError(EC.message(), Input);
+}
+
+namespace {
+/// Produces the costs of all files in decreasing order.
+class CostMerger {
+public:
+  CostMerger(const std::vector<std::unique_ptr<costfile::Reader>> &Readers) {
+    for (unsigned I = 0, E = Readers.size(); I != E; ++I) {
+      Records.push_back(Readers[I]->records());
+      if (!Records.back().empty())
+        Heap.push(std::make_pair(Records.back().front().Cost, I));
+    }
+  }
+
+  bool empty() const { return Heap.empty(); }
+
+  uint64_t peek() const { return Heap.top().first; }
+
+  uint64_t next() {
+    std::pair<uint64_t, unsigned> Top = Heap.top();
+    Heap.pop();
+    ArrayRef<costfile::Record> &R = Records[Top.second];
+    R = R.slice(1);
+    if (!R.empty()) {
+      if (R.front().Cost > Top.first)
+        exitWithError("cost file is not sorted by decreasing cost");
+      Heap.push(std::make_pair(R.front().Cost, Top.second));
+    }
+    return Top.first;
+  }
+
+private:
+  std::vector<ArrayRef<costfile::Record>> Records;
+  std::priority_queue<std::pair<uint64_t, unsigned>> Heap;
+};
+} // end anonymous namespace
+
+int main(int argc, const char *argv[]) {
+  // Print a stack trace if we signal out.
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y; // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "ASAP cost threshold\n");
+
+  if ((SanityLevel >= 0.0) + (CostLevel >= 0.0) + (OverheadBudget >= 0.0) != 1)
+    exitWithError("specify exactly one of -sanity-level, -cost-level or "
+                  "-asap-overhead-budget");
+
+  std::vector<std::unique_ptr<costfile::Reader>> Readers;
+  for (const std::string &Input : Inputs)
+    addInput(Input, Readers);
+
+  uint64_t NumChecks = 0;
+  uint64_t TotalCost = 0;
+  uint64_t BaselineCost = 0;
+  bool Calibrated = false;
+  for (const auto &R : Readers) {
+    NumChecks += R->getHeader().NumRecords;
+    TotalCost += R->getHeader().TotalCost;
+    BaselineCost += R->getHeader().BaselineCost;
+    Calibrated |= R->getHeader().Flags & costfile::CalibratedCosts;
+  }
+  if (NumChecks == 0)
+    exitWithError("no costs found");
+  if (TotalCost == 0)
+    exitWithError("all costs are zero");
+  if (OverheadBudget >= 0.0 && Calibrated)
+    exitWithError("-asap-overhead-budget needs estimated costs, but the costs "
+                  "were measured with -asap-calibration");
+
+  // An overhead budget is an upper bound for the cost of the remaining checks.
+  uint64_t BudgetCost = 0;
+  if (OverheadBudget >= 0.0)
+    BudgetCost = OverheadBudget / 100.0 * BaselineCost;
+
+  // Walk through groups of checks with equal cost, in order of decreasing
+  // cost. Removing all checks costing Cost or more is acceptable as long as
+  // enough checks (or enough cost) remain; the last acceptable group's cost
+  // becomes the threshold. With a budget, groups are removed until the
+  // remaining checks fit into it.
+  CostMerger Merger(Readers);
+  uint64_t Threshold = Merger.peek() + 1;
+  uint64_t NumRemoved = 0, RemovedCost = 0;
+  uint64_t NumSeen = 0, SeenCost = 0;
+  while (!Merger.empty()) {
+    if (OverheadBudget >= 0.0 && TotalCost - RemovedCost <= BudgetCost)
+      break;
+
+    uint64_t Cost = Merger.next();
+    NumSeen += 1;
+    SeenCost += Cost;
+    if (!Merger.empty() && Merger.peek() == Cost)
+      continue;
+
+    bool Acceptable;
+    if (SanityLevel >= 0.0) {
+      Acceptable = NumChecks - NumSeen >= NumChecks * SanityLevel;
+    } else {
+      // We never want to remove checks with cost zero
+      if (Cost == 0)
+        break;
+      Acceptable = OverheadBudget >= 0.0 ||
+                   TotalCost - SeenCost >= TotalCost * CostLevel;
+    }
+    if (!Acceptable)
+      break;
+
+    Threshold = Cost;
+    NumRemoved = NumSeen;
+    RemovedCost = SeenCost;
+  }
+
+  outs() << "Cost threshold is " << Threshold << "\n";
+  outs() << "Removing " << NumRemoved << " out of " << NumChecks
+         << " static checks ("
+         << format("%.2f", 100.0 * NumRemoved / NumChecks) << "%)\n";
+  outs() << "Removing " << RemovedCost << " out of " << TotalCost
+         << " dynamic checks ("
+         << format("%.2f", 100.0 * RemovedCost / TotalCost) << "%)\n";
+  if (BaselineCost > 0)
+    outs() << "Remaining checks cost "
+           << format("%.2f", 100.0 * (TotalCost - RemovedCost) / BaselineCost)
+           << "% of the baseline\n";
+  return 0;
+}
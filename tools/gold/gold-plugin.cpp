@@ -31,7 +31,9 @@
 #include "llvm/Linker/Linker.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/IRObjectFile.h"
+#include "llvm/ProfileData/LinkAllProfileData.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -42,6 +44,7 @@
 #include "llvm/Transforms/Utils/GlobalStatus.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
+#include <dlfcn.h>
 #include <list>
 #include <plugin-api.h>
 #include <system_error>
@@ -103,6 +106,23 @@ namespace options {
   // use only and will not be passed.
   static std::vector<const char *> extra;
 
+  // Gold opens plugins with RTLD_LOCAL. Libraries loaded with load= link
+  // against this plugin's copy of LLVM, so it has to be reopened with
+  // RTLD_GLOBAL first.
+  static bool make_plugin_global(std::string &Error) {
+    Dl_info Info;
+    if (!dladdr(reinterpret_cast<void *>(&make_plugin_global), &Info) ||
+        !Info.dli_fname) {
+      Error = "cannot find the path of the LLVM gold plugin";
+      return false;
+    }
+    if (!dlopen(Info.dli_fname, RTLD_NOW | RTLD_GLOBAL | RTLD_NOLOAD)) {
+      Error = dlerror();
+      return false;
+    }
+    return true;
+  }
+
   static void process_plugin_option(const char* opt_)
   {
     if (opt_ == nullptr)
@@ -119,6 +139,16 @@ namespace options {
       triple = opt.substr(strlen("mtriple="));
     } else if (opt.startswith("obj-path=")) {
       obj_path = opt.substr(strlen("obj-path="));
+    } else if (opt.startswith("load=")) {
+      // Load a library with additional passes, which can then add themselves
+      // to the LTO pipeline (see PassManagerBuilder's extension points) and
+      // be configured by the options that follow.
+      std::string Path = opt.substr(strlen("load="));
+      std::string Error;
+      if (!make_plugin_global(Error) ||
+          sys::DynamicLibrary::LoadLibraryPermanently(Path.c_str(), &Error))
+        message(LDPL_ERROR, "Unable to load %s: %s", Path.c_str(),
+                Error.c_str());
     } else if (opt == "emit-llvm") {
       TheOutputType = OT_BC_ONLY;
     } else if (opt == "save-temps") {
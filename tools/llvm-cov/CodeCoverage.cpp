@@ -22,6 +22,7 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/ProfileData/CoverageMapping.h"
+#include "llvm/ProfileData/CoverageSummary.h"
 #include "llvm/ProfileData/InstrProfReader.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
@@ -31,8 +32,13 @@
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <system_error>
+#include <thread>
 
 using namespace llvm;
 using namespace coverage;
@@ -45,7 +51,9 @@ public:
     /// \brief The show command.
     Show,
     /// \brief The report command.
-    Report
+    Report,
+    /// \brief The export command.
+    Export
   };
 
   /// \brief Print the error message to the error output stream.
@@ -67,6 +75,15 @@ public:
   std::unique_ptr<SourceCoverageView>
   createSourceFileView(StringRef SourceFile, CoverageMapping &Coverage);
 
+  /// \brief Render the view of the source file at \p Index in SourceFiles.
+  void renderSourceFile(raw_ostream &OS, size_t Index, bool ShowFilenames,
+                        CoverageMapping &Coverage);
+
+  /// \brief Render the views of all source files on \p NumThreads threads,
+  /// and print them in order.
+  void renderSourceFilesInParallel(unsigned NumThreads, bool ShowFilenames,
+                                   CoverageMapping &Coverage);
+
   /// \brief Load the coverage mapping data. Return true if an error occured.
   std::unique_ptr<CoverageMapping> load();
 
@@ -80,6 +97,9 @@ public:
   int report(int argc, const char **argv,
              CommandLineParserType commandLineParser);
 
+  int doExport(int argc, const char **argv,
+               CommandLineParserType commandLineParser);
+
   std::string ObjectFilename;
   CoverageViewOptions ViewOpts;
   std::string PGOFilename;
@@ -87,6 +107,8 @@ public:
   std::vector<std::string> SourceFiles;
   std::vector<std::pair<std::string, std::unique_ptr<MemoryBuffer>>>
       LoadedSourceFiles;
+  /// \brief Guards LoadedSourceFiles when views are rendered in parallel.
+  std::mutex LoadedSourceFilesLock;
   bool CompareFilenamesOnly;
   StringMap<std::string> RemappedFilenames;
   std::string CoverageArch;
@@ -108,6 +130,7 @@ CodeCoverageTool::getSourceFile(StringRef SourceFile) {
     if (Loc != RemappedFilenames.end())
       SourceFile = Loc->second;
   }
+  std::lock_guard<std::mutex> Lock(LoadedSourceFilesLock);
   for (const auto &Files : LoadedSourceFiles)
     if (sys::fs::equivalent(SourceFile, Files.first))
       return *Files.second;
@@ -194,6 +217,102 @@ CodeCoverageTool::createSourceFileView(StringRef SourceFile,
   return View;
 }
 
+void CodeCoverageTool::renderSourceFile(raw_ostream &OS, size_t Index,
+                                        bool ShowFilenames,
+                                        CoverageMapping &Coverage) {
+  const std::string &SourceFile = SourceFiles[Index];
+  auto mainView = createSourceFileView(SourceFile, Coverage);
+  if (!mainView) {
+    ViewOpts.colored_ostream(OS, raw_ostream::RED)
+        << "warning: The file '" << SourceFile << "' isn't covered.";
+    OS << "\n";
+    return;
+  }
+
+  if (ShowFilenames) {
+    ViewOpts.colored_ostream(OS, raw_ostream::CYAN) << SourceFile << ":";
+    OS << "\n";
+  }
+  mainView->render(OS, /*Wholefile=*/true);
+  if (SourceFiles.size() > 1)
+    OS << "\n";
+}
+
+namespace {
+/// \brief A string stream that keeps colors as escape sequences, so that
+/// output rendered into it can be printed later.
+class ColoredStringOstream : public raw_string_ostream {
+  raw_ostream &writeColor(const char *Code) {
+    if (Code)
+      *this << Code;
+    return *this;
+  }
+
+public:
+  ColoredStringOstream(std::string &Str) : raw_string_ostream(Str) {}
+
+  raw_ostream &changeColor(enum Colors Color, bool Bold = false,
+                           bool BG = false) override {
+    return writeColor(Color == SAVEDCOLOR
+                          ? sys::Process::OutputBold(BG)
+                          : sys::Process::OutputColor(Color, Bold, BG));
+  }
+  raw_ostream &resetColor() override {
+    return writeColor(sys::Process::ResetColor());
+  }
+  raw_ostream &reverseColor() override {
+    return writeColor(sys::Process::OutputReverse());
+  }
+};
+}
+
+void CodeCoverageTool::renderSourceFilesInParallel(unsigned NumThreads,
+                                                   bool ShowFilenames,
+                                                   CoverageMapping &Coverage) {
+  // Consoles that are colored through API calls rather than escape sequences
+  // cannot show colors from buffered output.
+  if (sys::Process::ColorNeedsFlush())
+    ViewOpts.Colors = false;
+
+  // Workers render the files in order of their index, and the main thread
+  // prints each one as soon as it and all the ones before it are done.
+  size_t NumFiles = SourceFiles.size();
+  std::vector<std::string> Rendered(NumFiles);
+  std::vector<bool> Done(NumFiles, false);
+  std::mutex DoneLock;
+  std::condition_variable DoneChanged;
+  std::atomic<size_t> Next(0);
+
+  auto Worker = [&]() {
+    for (size_t I = Next++; I < NumFiles; I = Next++) {
+      std::string Output;
+      {
+        ColoredStringOstream OS(Output);
+        renderSourceFile(OS, I, ShowFilenames, Coverage);
+      }
+      std::lock_guard<std::mutex> Lock(DoneLock);
+      Rendered[I] = std::move(Output);
+      Done[I] = true;
+      DoneChanged.notify_one();
+    }
+  };
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T < NumThreads; ++T)
+    Threads.push_back(std::thread(Worker));
+
+  for (size_t I = 0; I < NumFiles; ++I) {
+    std::string Output;
+    {
+      std::unique_lock<std::mutex> Lock(DoneLock);
+      DoneChanged.wait(Lock, [&] { return Done[I]; });
+      Output = std::move(Rendered[I]);
+    }
+    outs() << Output;
+  }
+  for (std::thread &T : Threads)
+    T.join();
+}
+
 static bool modifiedTimeGT(StringRef LHS, StringRef RHS) {
   sys::fs::file_status Status;
   if (sys::fs::status(LHS, Status))
@@ -373,6 +492,8 @@ int CodeCoverageTool::run(Command Cmd, int argc, const char **argv) {
     return show(argc, argv, commandLineParser);
   case Report:
     return report(argc, argv, commandLineParser);
+  case Export:
+    return doExport(argc, argv, commandLineParser);
   }
   return 0;
 }
@@ -406,6 +527,13 @@ int CodeCoverageTool::show(int argc, const char **argv,
                                    cl::desc("Show function instantiations"),
                                    cl::cat(ViewCategory));
 
+  cl::opt<unsigned> NumThreads(
+      "num-threads", cl::init(1),
+      cl::desc("Number of threads to render source files with "
+               "(0: one per hardware thread)"));
+  cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
+                        cl::aliasopt(NumThreads));
+
   auto Err = commandLineParser(argc, argv);
   if (Err)
     return Err;
@@ -452,24 +580,18 @@ int CodeCoverageTool::show(int argc, const char **argv,
     for (StringRef Filename : Coverage->getUniqueSourceFiles())
       SourceFiles.push_back(Filename);
 
-  for (const auto &SourceFile : SourceFiles) {
-    auto mainView = createSourceFileView(SourceFile, *Coverage);
-    if (!mainView) {
-      ViewOpts.colored_ostream(outs(), raw_ostream::RED)
-          << "warning: The file '" << SourceFile << "' isn't covered.";
-      outs() << "\n";
-      continue;
-    }
-
-    if (ShowFilenames) {
-      ViewOpts.colored_ostream(outs(), raw_ostream::CYAN) << SourceFile << ":";
-      outs() << "\n";
-    }
-    mainView->render(outs(), /*Wholefile=*/true);
-    if (SourceFiles.size() > 1)
-      outs() << "\n";
+  if (NumThreads == 0)
+    NumThreads = std::max(1u, std::thread::hardware_concurrency());
+  if (NumThreads > SourceFiles.size())
+    NumThreads = SourceFiles.size();
+  if (NumThreads > 1 && llvm_is_multithreaded()) {
+    renderSourceFilesInParallel(NumThreads, ShowFilenames, *Coverage);
+    return 0;
   }
 
+  for (size_t I = 0, E = SourceFiles.size(); I < E; ++I)
+    renderSourceFile(outs(), I, ShowFilenames, *Coverage);
+
   return 0;
 }
 
@@ -491,6 +613,74 @@ int CodeCoverageTool::report(int argc, const char **argv,
   return 0;
 }
 
+/// \brief Print the function summaries in \p Summary as text.
+static std::error_code printCoverageSummary(StringRef Summary,
+                                            raw_ostream &OS) {
+  auto ReaderOrErr = CoverageSummaryReader::create(
+      MemoryBuffer::getMemBuffer(Summary, "", false));
+  if (std::error_code EC = ReaderOrErr.getError())
+    return EC;
+  auto &Reader = ReaderOrErr.get();
+  FunctionSummary Function;
+  std::error_code EC;
+  while (!(EC = Reader->readNextFunction(Function))) {
+    OS << Function.Name << ": hash " << Function.FunctionHash
+       << ", count " << Function.ExecutionCount << "\n";
+    for (const auto &Region : Function.Regions) {
+      OS.indent(2 * Region.Depth + 2)
+          << sys::path::filename(Function.Filenames[Region.FileID]) << ":"
+          << Region.LineStart << ":" << Region.ColumnStart << " -> "
+          << Region.LineEnd << ":" << Region.ColumnEnd << ", count "
+          << Region.ExecutionCount << "\n";
+    }
+  }
+  if (EC == coveragemap_error::eof)
+    return std::error_code();
+  return EC;
+}
+
+int CodeCoverageTool::doExport(int argc, const char **argv,
+                               CommandLineParserType commandLineParser) {
+  cl::opt<std::string> OutputFilename(
+      "o", cl::desc("Output file for the function summaries"),
+      cl::value_desc("filename"), cl::init("-"));
+
+  cl::opt<bool> TextFormat(
+      "text", cl::desc("Print the summaries as indented text instead"));
+
+  auto Err = commandLineParser(argc, argv);
+  if (Err)
+    return Err;
+
+  if (modifiedTimeGT(ObjectFilename, PGOFilename))
+    errs() << "warning: profile data may be out of date - object is newer\n";
+
+  std::error_code EC;
+  raw_fd_ostream OS(OutputFilename, EC,
+                    TextFormat ? sys::fs::F_Text : sys::fs::F_None);
+  if (EC) {
+    error(EC.message(), OutputFilename);
+    return 1;
+  }
+  // The text format reads the binary summary back, so that it shows exactly
+  // what consumers of the binary format see.
+  std::string Summary;
+  raw_string_ostream SummaryOS(Summary);
+  EC = writeCoverageSummary(ObjectFilename, PGOFilename,
+                            TextFormat ? static_cast<raw_ostream &>(SummaryOS)
+                                       : OS,
+                            CoverageArch);
+  if (!EC && TextFormat)
+    EC = printCoverageSummary(SummaryOS.str(), OS);
+  if (EC) {
+    colored_ostream(errs(), raw_ostream::RED)
+        << "error: Failed to export coverage: " << EC.message();
+    errs() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
 int showMain(int argc, const char *argv[]) {
   CodeCoverageTool Tool;
   return Tool.run(CodeCoverageTool::Show, argc, argv);
@@ -500,3 +690,8 @@ int reportMain(int argc, const char *argv[]) {
   CodeCoverageTool Tool;
   return Tool.run(CodeCoverageTool::Report, argc, argv);
 }
+
+int exportMain(int argc, const char *argv[]) {
+  CodeCoverageTool Tool;
+  return Tool.run(CodeCoverageTool::Export, argc, argv);
+}
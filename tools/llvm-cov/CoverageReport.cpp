@@ -13,6 +13,7 @@
 
 #include "CoverageReport.h"
 #include "RenderingSupport.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 
@@ -200,15 +201,25 @@ void CoverageReport::renderFileReports(raw_ostream &OS) {
      << "\n";
   renderDivider(FileReportColumns, OS);
   OS << "\n";
+  // Summarize the functions in a single pass rather than once per file,
+  // which matters for reports of many files.
   FileCoverageSummary Totals("TOTAL");
+  StringMap<FileCoverageSummary> Summaries;
+  for (const auto &F : Coverage->getCoveredFunctions()) {
+    StringRef Filename = F.Filenames[0];
+    auto I = Summaries.find(Filename);
+    if (I == Summaries.end())
+      I = Summaries.insert(std::make_pair(Filename,
+                                          FileCoverageSummary(Filename)))
+              .first;
+    FunctionCoverageSummary Function = FunctionCoverageSummary::get(F);
+    I->second.addFunction(Function);
+    Totals.addFunction(Function);
+  }
   for (StringRef Filename : Coverage->getUniqueSourceFiles()) {
-    FileCoverageSummary Summary(Filename);
-    for (const auto &F : Coverage->getCoveredFunctions(Filename)) {
-      FunctionCoverageSummary Function = FunctionCoverageSummary::get(F);
-      Summary.addFunction(Function);
-      Totals.addFunction(Function);
-    }
-    render(Summary, OS);
+    auto I = Summaries.find(Filename);
+    render(I == Summaries.end() ? FileCoverageSummary(Filename) : I->second,
+           OS);
   }
   renderDivider(FileReportColumns, OS);
   OS << "\n";
@@ -11,6 +11,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/ProfileData/InstrProfReader.h"
@@ -25,7 +29,11 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using namespace llvm;
 
@@ -41,17 +49,89 @@ namespace {
 enum ProfileKinds { instr, sample };
 }
 
-static void mergeInstrProfile(const cl::list<std::string> &Inputs,
-                              StringRef OutputFilename) {
-  if (OutputFilename.compare("-") == 0)
-    exitWithError("Cannot write indexed profdata format to stdout.");
+/// Return the number of threads to merge \p NumInputs inputs with, given the
+/// -num-threads option. 0 means one per hardware thread.
+static unsigned getNumMergeThreads(unsigned Requested, size_t NumInputs) {
+  unsigned NumThreads = Requested;
+  if (NumThreads == 0)
+    NumThreads = std::max(1u, std::thread::hardware_concurrency());
+  if (NumThreads > NumInputs)
+    NumThreads = NumInputs;
+  if (!llvm_is_multithreaded())
+    NumThreads = 1;
+  return std::max(1u, NumThreads);
+}
 
-  std::error_code EC;
-  raw_fd_ostream Output(OutputFilename.data(), EC, sys::fs::F_None);
-  if (EC)
-    exitWithError(EC.message(), OutputFilename);
+/// Call \p Fn(Thread, I) for each I in [0, N), on \p NumThreads threads.
+/// Thread is the index of the calling thread, so that \p Fn can use
+/// per-thread state without locking.
+static void parallelForEach(unsigned NumThreads, size_t N,
+                            function_ref<void(unsigned, size_t)> Fn) {
+  // Each thread repeatedly grabs the next index, which balances the load
+  // between large and small inputs.
+  std::atomic<size_t> Next(0);
+  auto Worker = [&](unsigned Thread) {
+    for (size_t I = Next++; I < N; I = Next++)
+      Fn(Thread, I);
+  };
+  std::vector<std::thread> Threads;
+  for (unsigned T = 1; T < NumThreads; ++T)
+    Threads.push_back(std::thread(Worker, T));
+  Worker(0);
+  for (std::thread &T : Threads)
+    T.join();
+}
+
+/// Return the shard that holds the records of function \p Name.
+static unsigned getShard(StringRef Name, unsigned NumShards) {
+  return static_cast<size_t>(hash_value(Name)) % NumShards;
+}
 
+// Merging runs in three steps. First, the inputs are split into one
+// contiguous range per thread, and each thread adds the records of its range
+// to its own writers, one per shard of function names. Then, each shard of
+// all threads is merged into a single writer, in the order of the ranges.
+// Finally, the shards, which have no functions in common, are combined.
+//
+// The result is the same as when merging the inputs one after the other: the
+// first record of a function hash determines its number of counts, and later
+// records with a different number are dropped. Within a range, records that
+// do not match the first one of the range are kept aside, since whether they
+// match the first record of all inputs depends on the earlier ranges.
+
+namespace {
+/// A record that does not match the first record of its function hash in
+/// its range.
+struct MismatchedRecord {
+  size_t Input;
+  std::string Name;
+  uint64_t Hash;
+  std::vector<uint64_t> Counts;
+};
+
+/// The inputs whose counts were summed into a record of a range.
+struct RecordInputs {
+  size_t First;
+  size_t Count;
+};
+
+/// The records of one shard of function names, read from one range.
+struct MergeShard {
   InstrProfWriter Writer;
+  /// The inputs of each record in Writer, to report them if the record does
+  /// not match an earlier range.
+  StringMap<SmallDenseMap<uint64_t, RecordInputs, 1>> Inputs;
+  std::vector<MismatchedRecord> Mismatched;
+};
+}
+
+/// Merge the inputs one at a time, keeping at most about \p MemoryLimit bytes
+/// of counts in memory.
+static void mergeInstrProfileWithLimit(const cl::list<std::string> &Inputs,
+                                       raw_fd_ostream &Output,
+                                       StringRef OutputFilename,
+                                       size_t MemoryLimit) {
+  InstrProfSpillingWriter Writer(MemoryLimit);
   for (const auto &Filename : Inputs) {
     auto ReaderOrErr = InstrProfReader::create(Filename);
     if (std::error_code ec = ReaderOrErr.getError())
@@ -65,37 +145,177 @@ static void mergeInstrProfile(const cl::list<std::string> &Inputs,
     if (Reader->hasError())
       exitWithError(Reader->getError().message(), Filename);
   }
+  if (std::error_code EC =
+          Writer.write(Output, [](StringRef Name, std::error_code EC) {
+            errs() << Name << ": " << EC.message() << "\n";
+          }))
+    exitWithError(EC.message(), OutputFilename);
+}
+
+static void mergeInstrProfile(const cl::list<std::string> &Inputs,
+                              StringRef OutputFilename,
+                              unsigned NumThreads, size_t MemoryLimit) {
+  if (OutputFilename.compare("-") == 0)
+    exitWithError("Cannot write indexed profdata format to stdout.");
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputFilename.data(), EC, sys::fs::F_None);
+  if (EC)
+    exitWithError(EC.message(), OutputFilename);
+
+  if (MemoryLimit) {
+    mergeInstrProfileWithLimit(Inputs, Output, OutputFilename, MemoryLimit);
+    return;
+  }
+
+  NumThreads = getNumMergeThreads(NumThreads, Inputs.size());
+  // Shards[T * NumThreads + S] holds shard S of the records read from range T.
+  std::vector<MergeShard> Shards(NumThreads * NumThreads);
+  // Diagnostics are printed in the order of the inputs once all threads are
+  // done.
+  std::vector<std::string> Warnings(Inputs.size());
+  std::vector<std::string> Errors(Inputs.size());
+
+  parallelForEach(NumThreads, NumThreads, [&](unsigned, size_t Range) {
+    size_t Begin = Range * Inputs.size() / NumThreads;
+    size_t End = (Range + 1) * Inputs.size() / NumThreads;
+    for (size_t I = Begin; I < End; ++I) {
+      const std::string &Filename = Inputs[I];
+      auto ReaderOrErr = InstrProfReader::create(Filename);
+      if (std::error_code EC = ReaderOrErr.getError()) {
+        Errors[I] = EC.message();
+        return;
+      }
+
+      raw_string_ostream WarningOS(Warnings[I]);
+      auto Reader = std::move(ReaderOrErr.get());
+      for (const auto &R : *Reader) {
+        MergeShard &Shard =
+            Shards[Range * NumThreads + getShard(R.Name, NumThreads)];
+        std::error_code EC =
+            Shard.Writer.addFunctionCounts(R.Name, R.Hash, R.Counts);
+        if (EC == instrprof_error::count_mismatch) {
+          Shard.Mismatched.push_back({I, R.Name, R.Hash, R.Counts});
+        } else if (EC) {
+          WarningOS << Filename << ": " << R.Name << ": " << EC.message()
+                    << "\n";
+        } else if (Range != 0) {
+          // Records of the first range always come first.
+          auto Where = Shard.Inputs[R.Name].insert(
+              std::make_pair(R.Hash, RecordInputs{I, 0}));
+          ++Where.first->second.Count;
+        }
+      }
+      if (Reader->hasError()) {
+        Errors[I] = Reader->getError().message();
+        return;
+      }
+    }
+  });
+
+  for (size_t I = 0, E = Inputs.size(); I < E; ++I) {
+    errs() << Warnings[I];
+    if (!Errors[I].empty())
+      exitWithError(Errors[I], Inputs[I]);
+  }
+
+  std::vector<std::string> ShardWarnings(NumThreads);
+  parallelForEach(NumThreads, NumThreads, [&](unsigned, size_t S) {
+    raw_string_ostream WarningOS(ShardWarnings[S]);
+    InstrProfWriter &Writer = Shards[S].Writer;
+    auto AddMismatched = [&](const MergeShard &Shard) {
+      for (const MismatchedRecord &R : Shard.Mismatched)
+        if (std::error_code EC =
+                Writer.addFunctionCounts(R.Name, R.Hash, R.Counts))
+          WarningOS << Inputs[R.Input] << ": " << R.Name << ": "
+                    << EC.message() << "\n";
+    };
+    AddMismatched(Shards[S]);
+    for (unsigned T = 1; T < NumThreads; ++T) {
+      MergeShard &Shard = Shards[T * NumThreads + S];
+      Writer.mergeRecordsFromWriter(
+          std::move(Shard.Writer),
+          [&](StringRef Name, uint64_t Hash, std::error_code EC) {
+            const RecordInputs &RI = Shard.Inputs[Name][Hash];
+            WarningOS << Inputs[RI.First];
+            if (RI.Count > 1)
+              WarningOS << " (and " << RI.Count - 1 << " later inputs)";
+            WarningOS << ": " << Name << ": " << EC.message() << "\n";
+          });
+      AddMismatched(Shard);
+      Shard.Inputs.clear();
+      Shard.Mismatched.clear();
+    }
+  });
+  for (const std::string &W : ShardWarnings)
+    errs() << W;
+
+  InstrProfWriter &Writer = Shards[0].Writer;
+  for (unsigned S = 1; S < NumThreads; ++S)
+    Writer.mergeRecordsFromWriter(
+        std::move(Shards[S].Writer),
+        [](StringRef, uint64_t, std::error_code) {
+          llvm_unreachable("shards have no functions in common");
+        });
   Writer.write(Output);
 }
 
 static void mergeSampleProfile(const cl::list<std::string> &Inputs,
                                StringRef OutputFilename,
-                               sampleprof::SampleProfileFormat OutputFormat) {
+                               sampleprof::SampleProfileFormat OutputFormat,
+                               unsigned NumThreads) {
   using namespace sampleprof;
   auto WriterOrErr = SampleProfileWriter::create(OutputFilename, OutputFormat);
   if (std::error_code EC = WriterOrErr.getError())
     exitWithError(EC.message(), OutputFilename);
 
   auto Writer = std::move(WriterOrErr.get());
-  StringMap<FunctionSamples> ProfileMap;
-  for (const auto &Filename : Inputs) {
-    auto ReaderOrErr =
-        SampleProfileReader::create(Filename, getGlobalContext());
-    if (std::error_code EC = ReaderOrErr.getError())
-      exitWithError(EC.message(), Filename);
+  NumThreads = getNumMergeThreads(NumThreads, Inputs.size());
+  // ProfileMaps[T * NumThreads + S] holds shard S of the profiles read by T.
+  std::vector<StringMap<FunctionSamples>> ProfileMaps(NumThreads * NumThreads);
+  std::vector<std::string> Errors(Inputs.size());
+
+  parallelForEach(NumThreads, Inputs.size(), [&](unsigned Thread, size_t I) {
+    // The reader reports parse errors through its context, which must not be
+    // shared between threads.
+    LLVMContext Context;
+    auto ReaderOrErr = SampleProfileReader::create(Inputs[I], Context);
+    if (std::error_code EC = ReaderOrErr.getError()) {
+      Errors[I] = EC.message();
+      return;
+    }
 
     auto Reader = std::move(ReaderOrErr.get());
-    if (std::error_code EC = Reader->read())
-      exitWithError(EC.message(), Filename);
-
-    StringMap<FunctionSamples> &Profiles = Reader->getProfiles();
-    for (StringMap<FunctionSamples>::iterator I = Profiles.begin(),
-                                              E = Profiles.end();
-         I != E; ++I) {
-      StringRef FName = I->first();
-      FunctionSamples &Samples = I->second;
-      ProfileMap[FName].merge(Samples);
+    if (std::error_code EC = Reader->read()) {
+      Errors[I] = EC.message();
+      return;
+    }
+
+    for (const auto &P : Reader->getProfiles()) {
+      StringRef FName = P.getKey();
+      ProfileMaps[Thread * NumThreads + getShard(FName, NumThreads)][FName]
+          .merge(P.getValue());
+    }
+  });
+
+  for (size_t I = 0, E = Inputs.size(); I < E; ++I)
+    if (!Errors[I].empty())
+      exitWithError(Errors[I], Inputs[I]);
+
+  parallelForEach(NumThreads, NumThreads, [&](unsigned, size_t Shard) {
+    StringMap<FunctionSamples> &ShardMap = ProfileMaps[Shard];
+    for (unsigned T = 1; T < NumThreads; ++T) {
+      for (const auto &P : ProfileMaps[T * NumThreads + Shard])
+        ShardMap[P.getKey()].merge(P.getValue());
+      ProfileMaps[T * NumThreads + Shard].clear();
     }
+  });
+
+  StringMap<FunctionSamples> &ProfileMap = ProfileMaps[0];
+  for (unsigned Shard = 1; Shard < NumThreads; ++Shard) {
+    for (auto &P : ProfileMaps[Shard])
+      ProfileMap[P.getKey()] = std::move(P.getValue());
+    ProfileMaps[Shard].clear();
   }
   Writer->write(ProfileMap);
 }
@@ -123,12 +343,25 @@ static int merge_main(int argc, const char *argv[]) {
                  clEnumValN(sampleprof::SPF_GCC, "gcc", "GCC encoding"),
                  clEnumValEnd));
 
+  cl::opt<unsigned> NumThreads(
+      "num-threads", cl::init(1),
+      cl::desc("Number of threads to merge with (0: one per hardware "
+               "thread)"));
+  cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
+                        cl::aliasopt(NumThreads));
+
+  cl::opt<unsigned> MemoryLimit(
+      "memory-limit", cl::init(0), cl::value_desc("MiB"),
+      cl::desc("Spill counts to temporary files beyond this amount of memory, "
+               "and merge inputs on a single thread (instr only)"));
+
   cl::ParseCommandLineOptions(argc, argv, "LLVM profile data merger\n");
 
   if (ProfileKind == instr)
-    mergeInstrProfile(Inputs, OutputFilename);
+    mergeInstrProfile(Inputs, OutputFilename, NumThreads,
+                      size_t(MemoryLimit) << 20);
   else
-    mergeSampleProfile(Inputs, OutputFilename, OutputFormat);
+    mergeSampleProfile(Inputs, OutputFilename, OutputFormat, NumThreads);
 
   return 0;
 }
@@ -10,6 +10,7 @@
 #include "llvm/ProfileData/CoverageMapping.h"
 #include "llvm/ProfileData/CoverageMappingReader.h"
 #include "llvm/ProfileData/CoverageMappingWriter.h"
+#include "llvm/ProfileData/CoverageSummary.h"
 #include "llvm/ProfileData/InstrProfReader.h"
 #include "llvm/ProfileData/InstrProfWriter.h"
 #include "llvm/Support/raw_ostream.h"
@@ -288,4 +289,67 @@ TEST_F(CoverageMappingTest, strip_filename_prefix) {
   ASSERT_EQ("func", Names[0]);
 }
 
+TEST_F(CoverageMappingTest, summary_write_read) {
+  ProfileWriter.addFunctionCounts("func", 0x1234, {30, 20, 10, 0});
+  readProfCounts();
+
+  addCMR(Counter::getCounter(0), "file1", 1, 1, 9, 9);
+  addCMR(Counter::getCounter(2), "file1", 5, 8, 9, 1);
+  addCMR(Counter::getCounter(1), "file1", 1, 1, 4, 7);
+  addCMR(Counter::getCounter(3), "file1", 10, 10, 11, 11);
+  std::string Regions = writeCoverageRegions();
+  readCoverageRegions(Regions);
+
+  SmallVector<StringRef, 8> Filenames;
+  for (const auto &E : Files)
+    Filenames.push_back(E.getKey());
+  OneFunctionCoverageReader CovReader("func", 0x1234, Filenames, OutputCMRs);
+  std::string Summary;
+  raw_string_ostream OS(Summary);
+  ASSERT_TRUE(NoError(writeCoverageSummary(CovReader, *ProfileReader, OS)));
+  OS.flush();
+
+  auto ReaderOrErr = CoverageSummaryReader::create(
+      MemoryBuffer::getMemBuffer(Summary, "", false));
+  ASSERT_TRUE(NoError(ReaderOrErr.getError()));
+  auto Reader = std::move(ReaderOrErr.get());
+  FunctionSummary Function;
+  ASSERT_TRUE(NoError(Reader->readNextFunction(Function)));
+  ASSERT_EQ("func", Function.Name);
+  ASSERT_EQ(0x1234U, Function.FunctionHash);
+  ASSERT_EQ(30U, Function.ExecutionCount);
+  ASSERT_EQ(1U, Function.Filenames.size());
+  ASSERT_EQ("file1", Function.Filenames[0]);
+
+  ASSERT_EQ(4U, Function.Regions.size());
+  const unsigned Lines[] = {1, 1, 5, 10};
+  const unsigned Depths[] = {0, 1, 1, 0};
+  const uint64_t Counts[] = {30, 20, 10, 0};
+  for (unsigned I = 0; I < 4; ++I) {
+    ASSERT_EQ(Lines[I], Function.Regions[I].LineStart);
+    ASSERT_EQ(Depths[I], Function.Regions[I].Depth);
+    ASSERT_EQ(Counts[I], Function.Regions[I].ExecutionCount);
+  }
+  ASSERT_EQ(coveragemap_error::eof,
+            Reader->readNextFunction(Function));
+}
+
+TEST_F(CoverageMappingTest, summary_function_without_regions) {
+  readProfCounts();
+
+  OneFunctionCoverageReader CovReader("func", 0x1234, {"file1"}, {});
+  std::string Summary;
+  raw_string_ostream OS(Summary);
+  ASSERT_TRUE(NoError(writeCoverageSummary(CovReader, *ProfileReader, OS)));
+  OS.flush();
+
+  auto ReaderOrErr = CoverageSummaryReader::create(
+      MemoryBuffer::getMemBuffer(Summary, "", false));
+  ASSERT_TRUE(NoError(ReaderOrErr.getError()));
+  FunctionSummary Function;
+  ASSERT_TRUE(NoError(ReaderOrErr.get()->readNextFunction(Function)));
+  ASSERT_EQ(0U, Function.ExecutionCount);
+  ASSERT_TRUE(Function.Regions.empty());
+}
+
 } // end anonymous namespace
@@ -9,6 +9,8 @@
 
 #include "llvm/ProfileData/InstrProfReader.h"
 #include "llvm/ProfileData/InstrProfWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
 #include "gtest/gtest.h"
 
 #include <cstdarg>
@@ -91,6 +93,34 @@ TEST_F(InstrProfTest, get_function_counts) {
   ASSERT_TRUE(ErrorEquals(instrprof_error::unknown_function, EC));
 }
 
+TEST_F(InstrProfTest, get_function_counts_in_place) {
+  Writer.addFunctionCounts("foo", 0x1234, {1, 2});
+  Writer.addFunctionCounts("foo", 0x1235, {3, 4, 5});
+  auto Profile = Writer.writeBuffer();
+  readProfile(std::move(Profile));
+
+  ArrayRef<support::ulittle64_t> Counts;
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("foo", 0x1235, Counts)));
+  ASSERT_EQ(3U, Counts.size());
+  ASSERT_EQ(3U, Counts[0]);
+  ASSERT_EQ(4U, Counts[1]);
+  ASSERT_EQ(5U, Counts[2]);
+
+  uint64_t NameHash = Reader->getFunctionNameHash("foo");
+  ASSERT_TRUE(
+      NoError(Reader->getFunctionCounts("foo", NameHash, 0x1234, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(1U, Counts[0]);
+  ASSERT_EQ(2U, Counts[1]);
+
+  std::error_code EC;
+  EC = Reader->getFunctionCounts("foo", NameHash, 0x5678, Counts);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::hash_mismatch, EC));
+
+  EC = Reader->getFunctionCounts("bar", 0x1234, Counts);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::unknown_function, EC));
+}
+
 TEST_F(InstrProfTest, get_max_function_count) {
   Writer.addFunctionCounts("foo", 0x1234, {1ULL << 31, 2});
   Writer.addFunctionCounts("bar", 0, {1ULL << 63});
@@ -101,4 +131,113 @@ TEST_F(InstrProfTest, get_max_function_count) {
   ASSERT_EQ(1ULL << 63, Reader->getMaximumFunctionCount());
 }
 
+TEST_F(InstrProfTest, merge_records_from_writer) {
+  Writer.addFunctionCounts("foo", 0x1234, {1, 2});
+  Writer.addFunctionCounts("bar", 0x1234, {3, 4});
+
+  InstrProfWriter Other;
+  Other.addFunctionCounts("foo", 0x1234, {5, 6});
+  Other.addFunctionCounts("foo", 0x1235, {7});
+  Other.addFunctionCounts("bar", 0x1234, {8});
+  Other.addFunctionCounts("baz", 0x5678, {9, 10});
+
+  std::vector<std::string> Warnings;
+  Writer.mergeRecordsFromWriter(std::move(Other),
+                                [&](StringRef Name, uint64_t Hash,
+                                    std::error_code EC) {
+    ASSERT_TRUE(ErrorEquals(instrprof_error::count_mismatch, EC));
+    ASSERT_EQ(0x1234U, Hash);
+    Warnings.push_back(Name);
+  });
+  ASSERT_EQ(1U, Warnings.size());
+  ASSERT_EQ("bar", Warnings[0]);
+
+  auto Profile = Writer.writeBuffer();
+  readProfile(std::move(Profile));
+
+  std::vector<uint64_t> Counts;
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("foo", 0x1234, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(6U, Counts[0]);
+  ASSERT_EQ(8U, Counts[1]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("foo", 0x1235, Counts)));
+  ASSERT_EQ(1U, Counts.size());
+  ASSERT_EQ(7U, Counts[0]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("bar", 0x1234, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(3U, Counts[0]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("baz", 0x5678, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(9U, Counts[0]);
+
+  ASSERT_EQ(9U, Reader->getMaximumFunctionCount());
+}
+
+TEST_F(InstrProfTest, merge_records_from_writer_max_count) {
+  Writer.addFunctionCounts("foo", 0x1234, {1, 2});
+
+  // The record of foo in Other is dropped, so its count must not become the
+  // maximum function count.
+  InstrProfWriter Other;
+  Other.addFunctionCounts("foo", 0x1234, {100});
+  Other.addFunctionCounts("bar", 0x1234, {5, 6});
+
+  unsigned NumWarnings = 0;
+  Writer.mergeRecordsFromWriter(
+      std::move(Other),
+      [&](StringRef, uint64_t, std::error_code) { ++NumWarnings; });
+  ASSERT_EQ(1U, NumWarnings);
+
+  auto Profile = Writer.writeBuffer();
+  readProfile(std::move(Profile));
+
+  ASSERT_EQ(5U, Reader->getMaximumFunctionCount());
+}
+
+TEST_F(InstrProfTest, spilling_writer) {
+  // With no memory to spare, each new record is spilled to its own run.
+  InstrProfSpillingWriter SpillingWriter(0);
+  SpillingWriter.addFunctionCounts("foo", 0x1234, {1, 2});
+  SpillingWriter.addFunctionCounts("bar", 0x1234, {3, 4});
+  SpillingWriter.addFunctionCounts("foo", 0x1234, {5, 6});
+  SpillingWriter.addFunctionCounts("foo", 0x1235, {7});
+  SpillingWriter.addFunctionCounts("bar", 0x1234, {8});
+
+  int FD;
+  SmallString<128> Path;
+  ASSERT_TRUE(NoError(
+      sys::fs::createTemporaryFile("spilling-writer", "profdata", FD, Path)));
+  FileRemover Remover(Path);
+  std::vector<std::string> Warnings;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    ASSERT_TRUE(NoError(
+        SpillingWriter.write(OS, [&](StringRef Name, std::error_code EC) {
+          ASSERT_TRUE(ErrorEquals(instrprof_error::count_mismatch, EC));
+          Warnings.push_back(Name);
+        })));
+  }
+  ASSERT_EQ(1U, Warnings.size());
+  ASSERT_EQ("bar", Warnings[0]);
+
+  auto ReaderOrErr = IndexedInstrProfReader::create(Path.str());
+  ASSERT_TRUE(NoError(ReaderOrErr.getError()));
+  Reader = std::move(ReaderOrErr.get());
+
+  std::vector<uint64_t> Counts;
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("foo", 0x1234, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(6U, Counts[0]);
+  ASSERT_EQ(8U, Counts[1]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("foo", 0x1235, Counts)));
+  ASSERT_EQ(1U, Counts.size());
+  ASSERT_EQ(7U, Counts[0]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("bar", 0x1234, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(3U, Counts[0]);
+  ASSERT_EQ(4U, Counts[1]);
+
+  ASSERT_EQ(7U, Reader->getMaximumFunctionCount());
+}
+
 } // end anonymous namespace